@@ -14,11 +14,24 @@ static const short WRITE = 1;
 
 static const int OK = 0;
 
+/// The two fds a process uses towards one peer.
+typedef struct {
+    int c_read_fd;      ///< peer -> this process
+    int c_write_fd;     ///< this process -> peer
+    uint8_t c_closed;   ///< EOF read from c_read_fd, the peer has exited
+} Channel;
+
+/*
+ * Fields read on every send and receive come first, the full pipe matrix
+ * (only needed to close fds) and the ~1.5 KB history last. Pass it by
+ * pointer, never by value.
+ */
 typedef struct {
-    long num_process;
-    Pipe** pipes;
     int8_t pid;
+    long num_process;
+    Channel channels[MAX_PROCESS_ID + 1];   ///< filled by bind_channels()
     balance_t cur_balance;
+    Pipe** pipes;
     BalanceHistory history;
 } Process;
 
@@ -0,0 +1,31 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/// Each transfer advances Lamport time by up to 8, so more would wrap the int16 clock in events.log
+#define BENCH_MAX_TRANSFERS 4000
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/// Parses "a,b,c" into values, returns the number of parsed entries.
+static inline int bench_parse_list(const char *text, long *values, int max_values) {
+    int count = 0;
+    char *end = NULL;
+    while (*text && count < max_values) {
+        values[count++] = strtol(text, &end, 10);
+        if (end == text) {
+            return -1;
+        }
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+#endif
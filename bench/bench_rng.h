@@ -0,0 +1,41 @@
+#ifndef BENCH_RNG_H
+#define BENCH_RNG_H
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * splitmix64: tiny, seedable and good enough for workload generation, so a
+ * benchmark run is reproducible from its seed.
+ */
+typedef struct {
+    uint64_t state;
+} BenchRng;
+
+static inline void rng_seed(BenchRng *rng, uint64_t seed) {
+    rng->state = seed;
+}
+
+static inline uint64_t rng_next(BenchRng *rng) {
+    uint64_t z = (rng->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/// uniform in [0, 1)
+static inline double rng_uniform(BenchRng *rng) {
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// uniform integer in [0, bound)
+static inline uint32_t rng_below(BenchRng *rng, uint32_t bound) {
+    return (uint32_t) (rng_uniform(rng) * bound);
+}
+
+/// exponential with the given mean, inter-arrival times of a Poisson process
+static inline double rng_exponential(BenchRng *rng, double mean) {
+    return -mean * log(1.0 - rng_uniform(rng));
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef BENCH_STATS_H
+#define BENCH_STATS_H
+
+#include <math.h>
+#include <stdlib.h>
+
+/**
+ * Summary of one measurement repeated over several independent runs: the
+ * per-repetition values are treated as samples, and the 95% confidence
+ * interval of their mean uses Student's t, which matters for the handful
+ * of repetitions a benchmark can afford.
+ */
+typedef struct {
+    int    count;
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    double ci95;    ///< half-width of the 95% confidence interval of the mean
+} SampleSummary;
+
+static inline int bench_compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/// two-sided 95% quantile of Student's t with df degrees of freedom
+static inline double bench_t95(int df) {
+    static const double table[] = {
+        0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df <= 0) {
+        return 0;
+    }
+    return df < (int) (sizeof(table) / sizeof(table[0])) ? table[df] : 1.960;
+}
+
+/// Sorts samples in place.
+static inline SampleSummary bench_summarize(double *samples, int count) {
+    SampleSummary summary = {count, 0, 0, 0, 0, 0};
+    if (count == 0) {
+        return summary;
+    }
+    qsort(samples, count, sizeof(double), bench_compare_doubles);
+    summary.min = samples[0];
+    summary.median = (count % 2) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    for (int i = 0; i < count; i++) {
+        summary.mean += samples[i];
+    }
+    summary.mean /= count;
+    if (count > 1) {
+        double squares = 0;
+        for (int i = 0; i < count; i++) {
+            squares += (samples[i] - summary.mean) * (samples[i] - summary.mean);
+        }
+        summary.stddev = sqrt(squares / (count - 1));
+        summary.ci95 = bench_t95(count - 1) * summary.stddev / sqrt(count);
+    }
+    return summary;
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "hdr_histogram.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+static int bit_length(uint64_t value) {
+    return value ? 64 - __builtin_clzll(value) : 0;
+}
+
+static int bucket_index(const HdrHistogram* histogram, uint64_t value) {
+    uint64_t sub_bucket_mask = (1ull << histogram->sub_bucket_bits) - 1;
+    return bit_length(value | sub_bucket_mask) - histogram->sub_bucket_bits;
+}
+
+static int counts_index(const HdrHistogram* histogram, uint64_t value) {
+    int bucket = bucket_index(histogram, value);
+    int sub_bucket = (int) (value >> bucket);
+    return (bucket << (histogram->sub_bucket_bits - 1)) + sub_bucket;
+}
+
+static uint64_t lowest_value_at(const HdrHistogram* histogram, int index) {
+    int half_bits = histogram->sub_bucket_bits - 1;
+    int bucket = (index >> half_bits) - 1;
+    uint64_t sub_bucket = (index & ((1 << half_bits) - 1)) + (1u << half_bits);
+    if (bucket < 0) {
+        sub_bucket -= 1u << half_bits;
+        bucket = 0;
+    }
+    return sub_bucket << bucket;
+}
+
+static uint64_t highest_value_at(const HdrHistogram* histogram, int index) {
+    int bucket = bucket_index(histogram, lowest_value_at(histogram, index));
+    return lowest_value_at(histogram, index) + (1ull << bucket) - 1;
+}
+
+int hdr_init(HdrHistogram* histogram, uint64_t highest_trackable, int significant_digits) {
+    if (significant_digits < 1 || significant_digits > 5 || highest_trackable < 2) {
+        return -1;
+    }
+    uint64_t largest_single_unit = 2;
+    for (int digit = 0; digit < significant_digits; digit++) {
+        largest_single_unit *= 10;
+    }
+    memset(histogram, 0, sizeof(HdrHistogram));
+    histogram->highest_trackable = highest_trackable;
+    histogram->sub_bucket_bits = bit_length(largest_single_unit - 1);
+    histogram->counts_len = counts_index(histogram, highest_trackable) + 1;
+    histogram->counts = calloc(histogram->counts_len, sizeof(uint64_t));
+    if (histogram->counts == NULL) {
+        return -1;
+    }
+    hdr_reset(histogram);
+    return 0;
+}
+
+void hdr_free(HdrHistogram* histogram) {
+    free(histogram->counts);
+    histogram->counts = NULL;
+}
+
+void hdr_reset(HdrHistogram* histogram) {
+    memset(histogram->counts, 0, histogram->counts_len * sizeof(uint64_t));
+    histogram->total = 0;
+    histogram->min = UINT64_MAX;
+    histogram->max = 0;
+}
+
+void hdr_record(HdrHistogram* histogram, uint64_t value) {
+    if (value > histogram->highest_trackable) {
+        value = histogram->highest_trackable;
+    }
+    histogram->counts[counts_index(histogram, value)]++;
+    histogram->total++;
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+void hdr_merge(HdrHistogram* into, const HdrHistogram* from) {
+    int len = into->counts_len < from->counts_len ? into->counts_len : from->counts_len;
+    for (int index = 0; index < len; index++) {
+        into->counts[index] += from->counts[index];
+    }
+    into->total += from->total;
+    if (from->total > 0 && from->min < into->min) {
+        into->min = from->min;
+    }
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+uint64_t hdr_value_at_percentile(const HdrHistogram* histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0;
+    }
+    if (percentile >= 100.0) {
+        return histogram->max;
+    }
+    uint64_t wanted = (uint64_t) (percentile / 100.0 * histogram->total + 0.5);
+    if (wanted == 0) {
+        wanted = 1;
+    }
+    uint64_t seen = 0;
+    for (int index = 0; index < histogram->counts_len; index++) {
+        seen += histogram->counts[index];
+        if (seen >= wanted) {
+            uint64_t value = highest_value_at(histogram, index);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+double hdr_mean(const HdrHistogram* histogram) {
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (int index = 0; index < histogram->counts_len; index++) {
+        if (histogram->counts[index] == 0) {
+            continue;
+        }
+        uint64_t low = lowest_value_at(histogram, index);
+        uint64_t high = highest_value_at(histogram, index);
+        sum += (double) histogram->counts[index] * (low + (high - low) / 2.0);
+    }
+    return sum / histogram->total;
+}
@@ -0,0 +1,37 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Log-linear histogram in the spirit of HdrHistogram: every power-of-two
+ * range is split into the same number of linear sub-buckets, so recorded
+ * values keep a fixed number of significant digits from 1 up to
+ * highest_trackable with constant-time recording.
+ */
+typedef struct {
+    uint64_t  highest_trackable;
+    int       sub_bucket_bits;
+    int       counts_len;
+    uint64_t* counts;
+    uint64_t  total;
+    uint64_t  min;
+    uint64_t  max;
+} HdrHistogram;
+
+int hdr_init(HdrHistogram* histogram, uint64_t highest_trackable, int significant_digits);
+
+void hdr_free(HdrHistogram* histogram);
+
+void hdr_reset(HdrHistogram* histogram);
+
+void hdr_record(HdrHistogram* histogram, uint64_t value);
+
+void hdr_merge(HdrHistogram* into, const HdrHistogram* from);
+
+uint64_t hdr_value_at_percentile(const HdrHistogram* histogram, double percentile);
+
+double hdr_mean(const HdrHistogram* histogram);
+
+#endif
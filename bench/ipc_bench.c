@@ -0,0 +1,463 @@
+#define _DEFAULT_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../helpers.h"
+#include "../pipes_helper.h"
+#include "../out_queue.h"
+#include "bench_common.h"
+#include "bench_stats.h"
+#include "hdr_histogram.h"
+
+/*
+ * Microbenchmarks of the ipc.c primitives on their own: no banking logic,
+ * no event log, just a pipe mesh built with create_pipes() and peers that
+ * play a fixed role. Every measurement runs a warmup, then a number of
+ * repetitions of a fixed number of operations; each repetition yields one
+ * sample (its mean cost per operation) and the samples are summarized with
+ * a median and a 95% confidence interval. Individual operation latencies go
+ * to a histogram for percentiles.
+ */
+
+enum {
+    MAX_SIZES = 16,
+    PIPE_BUDGET = 32 * 1024,    ///< bytes in flight per pipe, well below the 64 KiB kernel buffer
+    BENCH_DATA = 0x40,          ///< outside the protocol's MessageType range
+    BENCH_CREDIT
+};
+
+typedef struct {
+    long warmup;
+    long reps;
+    long iters;
+    int  max_children;
+    long sizes[MAX_SIZES];
+    int  size_count;
+    int  json;
+    const char *only;
+} IpcBenchOptions;
+
+static IpcBenchOptions bench_options;
+
+typedef void (*PeerRole)(Process *peer, long param);
+
+typedef struct {
+    Process self;
+    Pipe  **pipes;
+    pid_t   peers[MAX_PROCESS_ID + 1];
+    FILE   *devnull;
+} Mesh;
+
+static void prepare_bench_message(Message *msg, int16_t type, uint16_t payload_len) {
+    msg->s_header.s_magic = MESSAGE_MAGIC;
+    msg->s_header.s_type = type;
+    msg->s_header.s_payload_len = payload_len;
+    msg->s_header.s_local_time = 0;
+}
+
+static void bench_send(Process *proc, local_id dst, Message *msg) {
+    if (send(proc, dst, msg) != 0) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void bench_receive(Process *proc, local_id src, Message *msg) {
+    if (receive(proc, src, msg) != 0) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+static long total_ops(void) {
+    return bench_options.warmup + bench_options.reps * bench_options.iters;
+}
+
+static void mesh_start(Mesh *mesh, int num_process, PeerRole role, long param) {
+    memset(mesh, 0, sizeof(Mesh));
+    mesh->devnull = fopen("/dev/null", "w");
+    if (mesh->devnull == NULL) {
+        perror("Failed to open /dev/null");
+        exit(EXIT_FAILURE);
+    }
+    mesh->pipes = create_pipes(num_process, mesh->devnull);
+    fflush(stdout);
+    for (local_id id = 1; id < num_process; id++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Fork failed");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            Process peer = {.pid = id, .num_process = num_process, .pipes = mesh->pipes};
+            bind_channels(&peer);
+            drop_pipes_that_non_rel(&peer, mesh->devnull);
+            role(&peer, param);
+            exit(out_queue_drain(peer.pid) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        mesh->peers[id] = pid;
+    }
+    Process self = {.pid = PARENT_ID, .num_process = num_process, .pipes = mesh->pipes};
+    bind_channels(&self);
+    mesh->self = self;
+    drop_pipes_that_non_rel(&mesh->self, mesh->devnull);
+}
+
+static void mesh_stop(Mesh *mesh, int kill_peers) {
+    out_queue_drain(PARENT_ID);
+    for (local_id id = 1; id < mesh->self.num_process; id++) {
+        if (kill_peers) {
+            kill(mesh->peers[id], SIGTERM);
+        }
+        waitpid(mesh->peers[id], NULL, 0);
+    }
+    drop_pipes_that_out(&mesh->self, mesh->devnull);
+    drop_pipes_that_in(&mesh->self, mesh->devnull);
+    free(mesh->pipes);
+    fclose(mesh->devnull);
+}
+
+/// Collects per-repetition samples while the measured loop runs.
+typedef struct {
+    const char   *name;
+    const char   *unit;
+    long          param;
+    double       *samples;
+    int           sample_count;
+    HdrHistogram  latency;
+    int           has_latency;
+    uint64_t      rep_start;
+} Measurement;
+
+static void measurement_init(Measurement *m, const char *name, const char *unit, long param, int has_latency) {
+    memset(m, 0, sizeof(Measurement));
+    m->name = name;
+    m->unit = unit;
+    m->param = param;
+    m->has_latency = has_latency;
+    m->samples = calloc(bench_options.reps, sizeof(double));
+    if (m->samples == NULL || hdr_init(&m->latency, 60ull * 1000000000ull, 3) != 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/// Called before operation op; returns 1 when op is measured (past the warmup).
+static int measurement_op(Measurement *m, long op) {
+    if (op < bench_options.warmup) {
+        return 0;
+    }
+    if ((op - bench_options.warmup) % bench_options.iters == 0) {
+        m->rep_start = bench_now_ns();
+    }
+    return 1;
+}
+
+/**
+ * Called after operation op; closes the repetition on its last operation.
+ * The sample is ns per operation, or units per second when the repetition
+ * moved rep_units of something (e.g. megabytes).
+ */
+static void measurement_op_done(Measurement *m, long op, double rep_units) {
+    if (op < bench_options.warmup || (op - bench_options.warmup + 1) % bench_options.iters != 0) {
+        return;
+    }
+    double elapsed_ns = bench_now_ns() - m->rep_start;
+    m->samples[m->sample_count++] = rep_units > 0 ? rep_units * 1e9 / elapsed_ns : elapsed_ns / bench_options.iters;
+}
+
+static void measurement_report(Measurement *m) {
+    SampleSummary summary = bench_summarize(m->samples, m->sample_count);
+    double p50 = m->has_latency ? hdr_value_at_percentile(&m->latency, 50.0) : 0;
+    double p99 = m->has_latency ? hdr_value_at_percentile(&m->latency, 99.0) : 0;
+    if (bench_options.json) {
+        printf("{\"bench\":\"ipc\",\"case\":\"%s\",\"param\":%ld,\"unit\":\"%s\",\"reps\":%d,\"iters\":%ld,"
+               "\"median\":%.1f,\"mean\":%.1f,\"ci95\":%.1f,\"stddev\":%.1f,\"min\":%.1f",
+               m->name, m->param, m->unit, summary.count, bench_options.iters,
+               summary.median, summary.mean, summary.ci95, summary.stddev, summary.min);
+        if (m->has_latency) {
+            printf(",\"p50_ns\":%.0f,\"p99_ns\":%.0f", p50, p99);
+        }
+        printf("}\n");
+    } else {
+        printf("%-12s %6ld %-8s %12.1f %12.1f %10.1f %12.1f", m->name, m->param, m->unit,
+               summary.median, summary.mean, summary.ci95, summary.min);
+        if (m->has_latency) {
+            printf(" %10.0f %10.0f", p50, p99);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+    hdr_free(&m->latency);
+    free(m->samples);
+}
+
+static int selected(const char *name) {
+    return bench_options.only == NULL || strcmp(bench_options.only, name) == 0;
+}
+
+/* one-way: the peer stamps each message, the parent returns a credit once it is read */
+
+static void oneway_peer(Process *peer, long size) {
+    Message msg;
+    for (long op = 0; op < total_ops(); op++) {
+        prepare_bench_message(&msg, BENCH_DATA, size);
+        uint64_t sent_ns = bench_now_ns();
+        memcpy(msg.s_payload, &sent_ns, sizeof(sent_ns));
+        bench_send(peer, PARENT_ID, &msg);
+        bench_receive(peer, PARENT_ID, &msg);
+    }
+}
+
+static void bench_oneway(long size) {
+    Measurement m;
+    measurement_init(&m, "oneway", "ns", size, 1);
+    Mesh mesh;
+    mesh_start(&mesh, 2, oneway_peer, size);
+    Message msg, credit;
+    prepare_bench_message(&credit, BENCH_CREDIT, 0);
+    double rep_sum = 0;
+    for (long op = 0; op < total_ops(); op++) {
+        bench_receive(&mesh.self, 1, &msg);
+        uint64_t sent_ns;
+        memcpy(&sent_ns, msg.s_payload, sizeof(sent_ns));
+        uint64_t latency = bench_now_ns() - sent_ns;
+        if (op >= bench_options.warmup) {
+            hdr_record(&m.latency, latency);
+            rep_sum += latency;
+            if ((op - bench_options.warmup + 1) % bench_options.iters == 0) {
+                m.samples[m.sample_count++] = rep_sum / bench_options.iters;
+                rep_sum = 0;
+            }
+        }
+        bench_send(&mesh.self, 1, &credit);
+    }
+    mesh_stop(&mesh, 0);
+    measurement_report(&m);
+}
+
+/* ping-pong: the peer echoes every message back */
+
+static void echo_peer(Process *peer, long unused) {
+    (void) unused;
+    Message msg;
+    for (long op = 0; op < total_ops(); op++) {
+        bench_receive(peer, PARENT_ID, &msg);
+        bench_send(peer, PARENT_ID, &msg);
+    }
+}
+
+static void bench_pingpong(long size) {
+    Measurement m;
+    measurement_init(&m, "pingpong", "ns", size, 1);
+    Mesh mesh;
+    mesh_start(&mesh, 2, echo_peer, 0);
+    Message msg;
+    for (long op = 0; op < total_ops(); op++) {
+        int measured = measurement_op(&m, op);
+        prepare_bench_message(&msg, BENCH_DATA, size);
+        uint64_t start_ns = bench_now_ns();
+        bench_send(&mesh.self, 1, &msg);
+        bench_receive(&mesh.self, 1, &msg);
+        if (measured) {
+            hdr_record(&m.latency, bench_now_ns() - start_ns);
+        }
+        measurement_op_done(&m, op, 0);
+    }
+    mesh_stop(&mesh, 0);
+    measurement_report(&m);
+}
+
+/* multicast: only the send_multicast() call is timed, the echoes keep the pipes drained */
+
+static void bench_multicast(int children) {
+    Measurement m;
+    measurement_init(&m, "multicast", "ns", children, 1);
+    Mesh mesh;
+    mesh_start(&mesh, children + 1, echo_peer, 0);
+    Message msg;
+    prepare_bench_message(&msg, BENCH_DATA, 0);
+    double rep_sum = 0;
+    for (long op = 0; op < total_ops(); op++) {
+        uint64_t start_ns = bench_now_ns();
+        if (send_multicast(&mesh.self, &msg) != 0) {
+            exit(EXIT_FAILURE);
+        }
+        uint64_t cost = bench_now_ns() - start_ns;
+        if (op >= bench_options.warmup) {
+            hdr_record(&m.latency, cost);
+            rep_sum += cost;
+            if ((op - bench_options.warmup + 1) % bench_options.iters == 0) {
+                m.samples[m.sample_count++] = rep_sum / bench_options.iters;
+                rep_sum = 0;
+            }
+        }
+        for (local_id id = 1; id <= children; id++) {
+            bench_receive(&mesh.self, id, &msg);
+        }
+    }
+    mesh_stop(&mesh, 0);
+    measurement_report(&m);
+}
+
+/* scan: cost of one receive_any() pass over idle channels; peers sleep so they do not steal the CPU */
+
+static void idle_peer(Process *peer, long unused) {
+    (void) peer;
+    (void) unused;
+    for (;;) {
+        pause();
+    }
+}
+
+static void bench_scan(int children) {
+    Measurement m;
+    measurement_init(&m, "scan", "ns", children, 0);
+    Mesh mesh;
+    mesh_start(&mesh, children + 1, idle_peer, 0);
+    Message msg;
+    for (long op = 0; op < total_ops(); op++) {
+        measurement_op(&m, op);
+        if (try_receive_any(&mesh.self, &msg) != 1) {
+            fprintf(stderr, "Error: idle channel returned a message\n");
+            exit(EXIT_FAILURE);
+        }
+        measurement_op_done(&m, op, 0);
+    }
+    mesh_stop(&mesh, 1);
+    measurement_report(&m);
+}
+
+/* throughput: the peer streams a window of messages, then waits for a credit */
+
+static long window_for(long size) {
+    long window = PIPE_BUDGET / (long) (sizeof(MessageHeader) + size);
+    return window > 0 ? window : 1;
+}
+
+static void stream_peer(Process *peer, long size) {
+    Message msg, credit;
+    prepare_bench_message(&msg, BENCH_DATA, size);
+    memset(msg.s_payload, 0x5A, size);
+    long window = window_for(size);
+    for (long op = 0; op < total_ops(); op++) {
+        for (long i = 0; i < window; i++) {
+            bench_send(peer, PARENT_ID, &msg);
+        }
+        bench_receive(peer, PARENT_ID, &credit);
+    }
+}
+
+static void bench_throughput(long size) {
+    Measurement m;
+    measurement_init(&m, "throughput", "MB/s", size, 0);
+    Mesh mesh;
+    mesh_start(&mesh, 2, stream_peer, size);
+    Message msg, credit;
+    prepare_bench_message(&credit, BENCH_CREDIT, 0);
+    long window = window_for(size);
+    double rep_megabytes = (double) bench_options.iters * window * (sizeof(MessageHeader) + size) / 1e6;
+    for (long op = 0; op < total_ops(); op++) {
+        measurement_op(&m, op);
+        for (long i = 0; i < window; i++) {
+            bench_receive(&mesh.self, 1, &msg);
+        }
+        bench_send(&mesh.self, 1, &credit);
+        measurement_op_done(&m, op, rep_megabytes);
+    }
+    mesh_stop(&mesh, 0);
+    measurement_report(&m);
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: ipc_bench [--warmup W] [--reps R] [--iters I] [--max-children N]\n"
+                    "                 [--sizes s1,s2,...] [--only oneway|pingpong|multicast|scan|throughput]\n"
+                    "                 [--json]\n");
+    exit(1);
+}
+
+static void parse_options(int argc, char *argv[], IpcBenchOptions *options) {
+    static const long default_sizes[] = {8, 64, 512, MAX_PAYLOAD_LEN};
+    options->warmup = 100;
+    options->reps = 10;
+    options->iters = 200;
+    options->max_children = MAX_PROCESS_ID;
+    options->size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(options->sizes, default_sizes, sizeof(default_sizes));
+    options->json = 0;
+    options->only = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            options->json = 1;
+            continue;
+        }
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+        }
+        if (strcmp(argv[i], "--warmup") == 0) {
+            options->warmup = atol(value);
+        } else if (strcmp(argv[i], "--reps") == 0) {
+            options->reps = atol(value);
+        } else if (strcmp(argv[i], "--iters") == 0) {
+            options->iters = atol(value);
+        } else if (strcmp(argv[i], "--max-children") == 0) {
+            options->max_children = atoi(value);
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            options->size_count = bench_parse_list(value, options->sizes, MAX_SIZES);
+        } else if (strcmp(argv[i], "--only") == 0) {
+            options->only = value;
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (options->warmup < 0 || options->reps <= 0 || options->iters <= 0 || options->size_count <= 0 ||
+        options->max_children < 1 || options->max_children > MAX_PROCESS_ID) {
+        usage();
+    }
+    for (int s = 0; s < options->size_count; s++) {
+        // the one-way case carries its send timestamp in the payload
+        if (options->sizes[s] < (long) sizeof(uint64_t) || options->sizes[s] > MAX_PAYLOAD_LEN) {
+            usage();
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    parse_options(argc, argv, &bench_options);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!bench_options.json) {
+        printf("# ipc microbenchmarks, warmup %ld, %ld reps x %ld ops, median / mean / 95%% CI over reps\n",
+               bench_options.warmup, bench_options.reps, bench_options.iters);
+        printf("%-12s %6s %-8s %12s %12s %10s %12s %10s %10s\n",
+               "case", "param", "unit", "median", "mean", "ci95", "min", "p50_ns", "p99_ns");
+    }
+    for (int s = 0; s < bench_options.size_count; s++) {
+        if (selected("oneway")) {
+            bench_oneway(bench_options.sizes[s]);
+        }
+        if (selected("pingpong")) {
+            bench_pingpong(bench_options.sizes[s]);
+        }
+    }
+    for (int children = 1; children <= bench_options.max_children; children++) {
+        if (selected("multicast")) {
+            bench_multicast(children);
+        }
+        if (selected("scan")) {
+            bench_scan(children);
+        }
+    }
+    for (int s = 0; s < bench_options.size_count; s++) {
+        if (selected("throughput")) {
+            bench_throughput(bench_options.sizes[s]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers.h"
+#include "../runner.h"
+#include "bench_common.h"
+#include "bench_rng.h"
+#include "hdr_histogram.h"
+
+/*
+ * Open-loop latency benchmark. Transfers are scheduled at a fixed offered
+ * rate no matter how fast ACKs come back, and latency is measured from the
+ * scheduled issue time, so a stalled system is charged for every transfer
+ * it delayed instead of hiding it (coordinated omission).
+ */
+
+enum {
+    MAX_RATES = 32,
+    CHILD_BALANCE = 30000
+};
+
+typedef enum {
+    ARRIVAL_CONSTANT,
+    ARRIVAL_POISSON
+} ArrivalModel;
+
+typedef struct {
+    int          children;
+    long         rates[MAX_RATES];
+    int          rate_count;
+    long         transfers;
+    long         window;
+    ArrivalModel arrival;
+    uint64_t     seed;
+} LatencyOptions;
+
+typedef struct {
+    const LatencyOptions *options;
+    long                  rate;
+    BenchRng              rng;
+    HdrHistogram          latency;
+    uint64_t             *intended_ns;
+    uint64_t              elapsed_ns;
+    long                  completed;
+} LatencyRun;
+
+static double next_interval_ns(LatencyRun *run) {
+    double mean = 1e9 / run->rate;
+    if (run->options->arrival == ARRIVAL_POISSON) {
+        return rng_exponential(&run->rng, mean);
+    }
+    return mean;
+}
+
+static void pick_pair(LatencyRun *run, int children, local_id *src, local_id *dst) {
+    *src = 1 + rng_below(&run->rng, children);
+    *dst = 1 + rng_below(&run->rng, children - 1);
+    if (*dst >= *src) {
+        (*dst)++;
+    }
+}
+
+static int collect_ack(Process *parent, LatencyRun *run, balance_t *available) {
+    Message ack;
+    int status = transfer_poll_ack(parent, &ack);
+    if (status != 0) {
+        return status;
+    }
+    uint32_t seq;
+    TransferOrder order;
+    if (ack.s_header.s_payload_len != sizeof(seq) + sizeof(order)) {
+        fprintf(stderr, "Error: ACK without benchmark tag\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&seq, ack.s_payload, sizeof(seq));
+    memcpy(&order, ack.s_payload + sizeof(seq), sizeof(order));
+    available[order.s_dst] += order.s_amount;
+    hdr_record(&run->latency, bench_now_ns() - run->intended_ns[seq]);
+    run->completed++;
+    return 0;
+}
+
+static void open_loop_workload(Process *parent, void *workload_arg) {
+    LatencyRun *run = workload_arg;
+    const LatencyOptions *options = run->options;
+    int children = parent->num_process - 1;
+    balance_t available[MAX_PROCESS_ID + 1];
+    for (int id = 1; id <= children; id++) {
+        available[id] = CHILD_BALANCE;
+    }
+
+    uint64_t start_ns = bench_now_ns();
+    double next_ns = start_ns;
+    long issued = 0;
+    while (run->completed < options->transfers) {
+        int outstanding = issued - run->completed;
+        if (issued < options->transfers && outstanding < options->window && bench_now_ns() >= (uint64_t) next_ns) {
+            local_id src, dst;
+            pick_pair(run, children, &src, &dst);
+            balance_t amount = available[src] > 0 ? 1 : 0;
+            available[src] -= amount;
+
+            uint32_t seq = issued;
+            TransferOrder order = {src, dst, amount};
+            char tail[sizeof(seq) + sizeof(order)];
+            memcpy(tail, &seq, sizeof(seq));
+            memcpy(tail + sizeof(seq), &order, sizeof(order));
+            run->intended_ns[seq] = (uint64_t) next_ns;
+            transfer_issue(parent, src, dst, amount, tail, sizeof(tail));
+
+            issued++;
+            next_ns += next_interval_ns(run);
+            continue;
+        }
+        if (collect_ack(parent, run, available) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    run->elapsed_ns = bench_now_ns() - start_ns;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: latency_bench [-p children] [--rates r1,r2,...] [--transfers K]\n"
+                    "                     [--window W] [--arrival constant|poisson] [--seed S]\n"
+                    "  transfers up to %d\n", BENCH_MAX_TRANSFERS);
+    exit(1);
+}
+
+static void parse_options(int argc, char *argv[], LatencyOptions *options) {
+    options->children = 4;
+    options->rates[0] = 1000;
+    options->rates[1] = 5000;
+    options->rates[2] = 20000;
+    options->rate_count = 3;
+    options->transfers = BENCH_MAX_TRANSFERS;
+    options->window = 256;
+    options->arrival = ARRIVAL_POISSON;
+    options->seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            options->children = atoi(value);
+        } else if (strcmp(argv[i], "--rates") == 0) {
+            options->rate_count = bench_parse_list(value, options->rates, MAX_RATES);
+        } else if (strcmp(argv[i], "--transfers") == 0) {
+            options->transfers = atol(value);
+        } else if (strcmp(argv[i], "--window") == 0) {
+            options->window = atol(value);
+        } else if (strcmp(argv[i], "--arrival") == 0) {
+            options->arrival = strcmp(value, "constant") == 0 ? ARRIVAL_CONSTANT : ARRIVAL_POISSON;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (options->children < 2 || options->children > MAX_PROCESS_ID || options->rate_count <= 0 ||
+        options->transfers <= 0 || options->transfers > BENCH_MAX_TRANSFERS || options->window <= 0) {
+        usage();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    LatencyOptions options;
+    parse_options(argc, argv, &options);
+
+    int balances[MAX_PROCESS_ID];
+    for (int id = 0; id < options.children; id++) {
+        balances[id] = CHILD_BALANCE;
+    }
+
+    printf("# open-loop latency, %d children, %ld transfers per rate, %s arrivals, window %ld, seed %llu\n",
+           options.children, options.transfers,
+           options.arrival == ARRIVAL_POISSON ? "poisson" : "constant", options.window,
+           (unsigned long long) options.seed);
+    printf("%10s %10s %10s %10s %10s %10s %10s\n",
+           "offered/s", "achieved/s", "p50_us", "p99_us", "p99.9_us", "max_us", "mean_us");
+
+    for (int r = 0; r < options.rate_count; r++) {
+        LatencyRun run;
+        memset(&run, 0, sizeof(run));
+        run.options = &options;
+        run.rate = options.rates[r];
+        rng_seed(&run.rng, options.seed + r);
+        run.intended_ns = calloc(options.transfers, sizeof(uint64_t));
+        if (run.intended_ns == NULL || hdr_init(&run.latency, 60ull * 1000000000ull, 3) != 0) {
+            fprintf(stderr, "Error: out of memory\n");
+            return 1;
+        }
+
+        RunConfig config;
+        memset(&config, 0, sizeof(config));
+        config.num_processes = options.children + 1;
+        config.balances = balances;
+        config.workload = open_loop_workload;
+        config.workload_arg = &run;
+        config.events_capacity = 4 * options.transfers + 4 * MAX_PROCESS_ID;
+        run_processes(&config);
+
+        printf("%10ld %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n", run.rate,
+               run.completed * 1e9 / run.elapsed_ns,
+               hdr_value_at_percentile(&run.latency, 50.0) / 1e3,
+               hdr_value_at_percentile(&run.latency, 99.0) / 1e3,
+               hdr_value_at_percentile(&run.latency, 99.9) / 1e3,
+               run.latency.max / 1e3, hdr_mean(&run.latency) / 1e3);
+        fflush(stdout);
+
+        hdr_free(&run.latency);
+        free(run.intended_ns);
+    }
+    return 0;
+}
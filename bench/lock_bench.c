@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers.h"
+#include "../runner.h"
+#include "bench_common.h"
+#include "workloads.h"
+
+/*
+ * Lock throughput against the number of children, per mutex algorithm and
+ * contention pattern. A run is children * K critical sections with an
+ * empty body; the owner of each one is the source of a seeded transfer
+ * workload, so "uniform" spreads them evenly and "zipf" piles them on a few
+ * hot children that re-enter back to back. Every child replays the same
+ * sequence and takes its own entries, the parent only runs the
+ * STARTED/STOP/DONE frame around them. Entries per second come from the
+ * longest transfer phase of the run, the messages per entry from the CS_*
+ * counters of the IPC stats.
+ */
+
+enum {
+    MAX_MUTEXES = 3,
+    MAX_WORKLOADS = 2,
+    CHILD_BALANCE = 10
+};
+
+typedef struct {
+    int            min_children;
+    int            max_children;
+    long           entries;
+    MutexAlgorithm mutexes[MAX_MUTEXES];
+    int            mutex_count;
+    WorkloadKind   workloads[MAX_WORKLOADS];
+    int            workload_count;
+    uint64_t       seed;
+    double         zipf_exponent;
+    int            json;
+} LockOptions;
+
+typedef struct {
+    const LockOptions *options;
+    WorkloadKind       workload;
+    int                children;
+} LockPoint;
+
+static void lock_workload(Process *child_proc, void *workload_arg) {
+    const LockPoint *point = workload_arg;
+    Workload workload;
+    workload_init(&workload, point->workload, point->children, point->options->seed, point->options->zipf_exponent);
+    for (long i = 0; i < point->children * point->options->entries; i++) {
+        local_id owner, unused;
+        workload_next(&workload, &owner, &unused);
+        if (owner != child_proc->pid) {
+            continue;
+        }
+        if (request_cs(child_proc) != 0 || release_cs(child_proc) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void idle_workload(Process *parent_proc, void *workload_arg) {
+    (void) parent_proc;
+    (void) workload_arg;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: lock_bench [--children MIN,MAX] [--entries K] [--mutex ra,lamport,sk]\n"
+                    "                  [--workload uniform,zipf] [--seed S] [--zipf-s exponent] [--json]\n"
+                    "  K is the number of entries per child on average\n");
+    exit(1);
+}
+
+static int parse_mutexes(char *list, LockOptions *options) {
+    options->mutex_count = 0;
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        if (options->mutex_count == MAX_MUTEXES ||
+            mutex_parse(name, &options->mutexes[options->mutex_count]) != 0) {
+            return -1;
+        }
+        options->mutex_count++;
+    }
+    return options->mutex_count > 0 ? 0 : -1;
+}
+
+static int parse_workloads(char *list, LockOptions *options) {
+    options->workload_count = 0;
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        if (options->workload_count == MAX_WORKLOADS ||
+            workload_parse(name, &options->workloads[options->workload_count]) != 0 ||
+            (options->workloads[options->workload_count] != WORKLOAD_UNIFORM &&
+             options->workloads[options->workload_count] != WORKLOAD_ZIPF)) {
+            return -1;
+        }
+        options->workload_count++;
+    }
+    return options->workload_count > 0 ? 0 : -1;
+}
+
+static void parse_options(int argc, char *argv[], LockOptions *options) {
+    options->min_children = 2;
+    options->max_children = MAX_PROCESS_ID;
+    options->entries = 100;
+    for (int i = 0; i < MAX_MUTEXES; i++) {
+        options->mutexes[i] = i;
+    }
+    options->mutex_count = MAX_MUTEXES;
+    options->workloads[0] = WORKLOAD_UNIFORM;
+    options->workloads[1] = WORKLOAD_ZIPF;
+    options->workload_count = MAX_WORKLOADS;
+    options->seed = 1;
+    options->zipf_exponent = 1.0;
+    options->json = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            options->json = 1;
+            continue;
+        }
+        char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+        }
+        if (strcmp(argv[i], "--children") == 0) {
+            long range[2];
+            if (bench_parse_list(value, range, 2) != 2) {
+                usage();
+            }
+            options->min_children = range[0];
+            options->max_children = range[1];
+        } else if (strcmp(argv[i], "--entries") == 0) {
+            options->entries = atol(value);
+        } else if (strcmp(argv[i], "--mutex") == 0) {
+            if (parse_mutexes(value, options) != 0) {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--workload") == 0) {
+            if (parse_workloads(value, options) != 0) {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--zipf-s") == 0) {
+            options->zipf_exponent = atof(value);
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (options->min_children < 1 || options->max_children > MAX_PROCESS_ID ||
+        options->min_children > options->max_children || options->entries <= 0 ||
+        options->zipf_exponent < 0) {
+        usage();
+    }
+}
+
+static void print_point(const LockOptions *options, MutexAlgorithm mutex, const LockPoint *point,
+                        const RunResult *result) {
+    double entries = (double) point->children * options->entries;
+    double seconds = result->phase_wall_ns[PHASE_TRANSFERS] / 1e9;
+    double messages_per_entry = result->cs_messages / entries;
+    if (options->json) {
+        printf("{\"bench\":\"lock\",\"mutex\":\"%s\",\"workload\":\"%s\",\"children\":%d,\"entries\":%.0f,"
+               "\"seed\":%llu,\"zipf_s\":%.3f,\"entries_per_sec\":%.1f,"
+               "\"cs_messages\":%llu,\"messages_per_entry\":%.2f}\n",
+               mutex_name(mutex), workload_name(point->workload), point->children, entries,
+               (unsigned long long) options->seed, options->zipf_exponent, entries / seconds,
+               (unsigned long long) result->cs_messages, messages_per_entry);
+    } else {
+        printf("%8s %8s %8d %12.0f %12.2f\n", mutex_name(mutex), workload_name(point->workload),
+               point->children, entries / seconds, messages_per_entry);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    LockOptions options;
+    parse_options(argc, argv, &options);
+
+    int balances[MAX_PROCESS_ID];
+    for (int id = 0; id < MAX_PROCESS_ID; id++) {
+        balances[id] = CHILD_BALANCE;
+    }
+
+    if (!options.json) {
+        printf("# lock sweep, %ld entries per child on average, seed %llu\n",
+               options.entries, (unsigned long long) options.seed);
+        printf("%8s %8s %8s %12s %12s\n", "mutex", "workload", "children", "entries/s", "msgs/entry");
+    }
+
+    for (int w = 0; w < options.workload_count; w++) {
+        for (int m = 0; m < options.mutex_count; m++) {
+            for (int children = options.min_children; children <= options.max_children; children++) {
+                LockPoint point = {.options = &options, .workload = options.workloads[w], .children = children};
+                RunResult result;
+                RunConfig config;
+                memset(&config, 0, sizeof(config));
+                config.num_processes = children + 1;
+                config.balances = balances;
+                config.options.mutex = options.mutexes[m];
+                config.workload = idle_workload;
+                config.child_workload = lock_workload;
+                config.child_workload_arg = &point;
+                config.result = &result;
+                run_processes(&config);
+
+                print_point(&options, options.mutexes[m], &point, &result);
+            }
+        }
+    }
+    return 0;
+}
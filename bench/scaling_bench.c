@@ -0,0 +1,205 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../helpers.h"
+#include "../runner.h"
+#include "bench_common.h"
+#include "hdr_histogram.h"
+#include "workloads.h"
+
+/*
+ * Scalability sweep. The same closed-loop uniform workload is run for every
+ * process count and every TRANSFER payload size in the grid; the payload is
+ * padded through the transfer tail, which the destination echoes back in
+ * its ACK, so both directions carry it. Each grid point reports how long
+ * the pipe mesh and STARTED barrier took to come up, the sustained
+ * transfer rate and the per-transfer round trip latency.
+ */
+
+enum {
+    MAX_SIZES = 16,
+    CHILD_BALANCE = 30000
+};
+
+typedef struct {
+    int      min_children;
+    int      max_children;
+    long     sizes[MAX_SIZES];
+    int      size_count;
+    long     transfers;
+    uint64_t seed;
+    int      json;
+} ScalingOptions;
+
+typedef struct {
+    const ScalingOptions *options;
+    uint16_t              tail_len;
+    Workload              workload;
+    HdrHistogram          latency;
+    uint64_t              launch_ns;
+    uint64_t              startup_ns;
+    uint64_t              elapsed_ns;
+} ScalingPoint;
+
+static void sweep_workload(Process *parent, void *workload_arg) {
+    ScalingPoint *point = workload_arg;
+    uint64_t start_ns = bench_now_ns();
+    point->startup_ns = start_ns - point->launch_ns;
+
+    int children = parent->num_process - 1;
+    balance_t available[MAX_PROCESS_ID + 1];
+    for (int id = 1; id <= children; id++) {
+        available[id] = CHILD_BALANCE;
+    }
+    char tail[TRANSFER_TAIL_MAX];
+    memset(tail, 0xA5, sizeof(tail));
+
+    for (long i = 0; i < point->options->transfers; i++) {
+        local_id src, dst;
+        workload_next(&point->workload, &src, &dst);
+        balance_t amount = available[src] > 0 ? 1 : 0;
+        available[src] -= amount;
+        available[dst] += amount;
+
+        uint64_t issued_ns = bench_now_ns();
+        transfer_issue(parent, src, dst, amount, tail, point->tail_len);
+        Message ack;
+        int status;
+        while ((status = transfer_poll_ack(parent, &ack)) == 1) {
+        }
+        if (status < 0) {
+            exit(EXIT_FAILURE);
+        }
+        hdr_record(&point->latency, bench_now_ns() - issued_ns);
+    }
+    point->elapsed_ns = bench_now_ns() - start_ns;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: scaling_bench [--children MIN,MAX] [--sizes s1,s2,...] [--transfers K]\n"
+                    "                     [--seed S] [--json]\n"
+                    "  sizes are TRANSFER payload bytes, %d..%d\n",
+            (int) sizeof(TransferOrder), (int) MAX_PAYLOAD_LEN);
+    exit(1);
+}
+
+static void parse_options(int argc, char *argv[], ScalingOptions *options) {
+    static const long default_sizes[] = {0, 64, 512, 2048, MAX_PAYLOAD_LEN};
+    options->min_children = 2;
+    options->max_children = MAX_PROCESS_ID;
+    options->size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(options->sizes, default_sizes, sizeof(default_sizes));
+    options->transfers = 1000;
+    options->seed = 1;
+    options->json = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            options->json = 1;
+            continue;
+        }
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+        }
+        if (strcmp(argv[i], "--children") == 0) {
+            long range[2];
+            if (bench_parse_list(value, range, 2) != 2) {
+                usage();
+            }
+            options->min_children = range[0];
+            options->max_children = range[1];
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            options->size_count = bench_parse_list(value, options->sizes, MAX_SIZES);
+        } else if (strcmp(argv[i], "--transfers") == 0) {
+            options->transfers = atol(value);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (options->min_children < 2 || options->max_children > MAX_PROCESS_ID ||
+        options->min_children > options->max_children || options->size_count <= 0 || options->transfers <= 0) {
+        usage();
+    }
+    // a TRANSFER always carries its TransferOrder, smaller sizes mean "bare"
+    for (int s = 0; s < options->size_count; s++) {
+        if (options->sizes[s] < (long) sizeof(TransferOrder)) {
+            options->sizes[s] = sizeof(TransferOrder);
+        }
+        if (options->sizes[s] > MAX_PAYLOAD_LEN) {
+            usage();
+        }
+    }
+}
+
+static void print_point(const ScalingOptions *options, int children, long size, ScalingPoint *point) {
+    double seconds = point->elapsed_ns / 1e9;
+    if (options->json) {
+        printf("{\"bench\":\"scaling\",\"children\":%d,\"payload\":%ld,\"transfers\":%ld,\"seed\":%llu,"
+               "\"startup_ns\":%llu,\"transfers_per_sec\":%.1f,"
+               "\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu,\"mean_ns\":%.1f}\n",
+               children, size, options->transfers, (unsigned long long) options->seed,
+               (unsigned long long) point->startup_ns, options->transfers / seconds,
+               (unsigned long long) hdr_value_at_percentile(&point->latency, 50.0),
+               (unsigned long long) hdr_value_at_percentile(&point->latency, 99.0),
+               (unsigned long long) point->latency.max, hdr_mean(&point->latency));
+    } else {
+        printf("%8d %8ld %12.2f %12.0f %10.1f %10.1f %10.1f\n", children, size,
+               point->startup_ns / 1e6, options->transfers / seconds,
+               hdr_value_at_percentile(&point->latency, 50.0) / 1e3,
+               hdr_value_at_percentile(&point->latency, 99.0) / 1e3,
+               hdr_mean(&point->latency) / 1e3);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    ScalingOptions options;
+    parse_options(argc, argv, &options);
+
+    int balances[MAX_PROCESS_ID];
+    for (int id = 0; id < MAX_PROCESS_ID; id++) {
+        balances[id] = CHILD_BALANCE;
+    }
+
+    if (!options.json) {
+        printf("# scaling sweep, %ld closed-loop uniform transfers per point, seed %llu\n",
+               options.transfers, (unsigned long long) options.seed);
+        printf("%8s %8s %12s %12s %10s %10s %10s\n",
+               "children", "payload", "startup_ms", "transfers/s", "p50_us", "p99_us", "mean_us");
+    }
+
+    for (int children = options.min_children; children <= options.max_children; children++) {
+        for (int s = 0; s < options.size_count; s++) {
+            ScalingPoint point;
+            memset(&point, 0, sizeof(point));
+            point.options = &options;
+            point.tail_len = options.sizes[s] - sizeof(TransferOrder);
+            workload_init(&point.workload, WORKLOAD_UNIFORM, children, options.seed, 0);
+            if (hdr_init(&point.latency, 60ull * 1000000000ull, 3) != 0) {
+                fprintf(stderr, "Error: out of memory\n");
+                return 1;
+            }
+
+            RunConfig config;
+            memset(&config, 0, sizeof(config));
+            config.num_processes = children + 1;
+            config.balances = balances;
+            config.workload = sweep_workload;
+            config.workload_arg = &point;
+            config.events_capacity = 4 * options.transfers + 4 * MAX_PROCESS_ID;
+            point.launch_ns = bench_now_ns();
+            run_processes(&config);
+
+            print_point(&options, children, options.sizes[s], &point);
+            hdr_free(&point.latency);
+        }
+    }
+    return 0;
+}
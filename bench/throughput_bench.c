@@ -0,0 +1,159 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../banking.h"
+#include "../runner.h"
+#include "bench_common.h"
+#include "workloads.h"
+
+/*
+ * Closed-loop throughput benchmark. The parent issues the next transfer
+ * as soon as the previous one is acknowledged, so the rate measured is what
+ * the transfer path sustains end to end. One JSON object is printed per
+ * workload so results can be diffed across builds.
+ */
+
+enum {
+    MAX_WORKLOADS = 4,
+    CHILD_BALANCE = 30000
+};
+
+typedef struct {
+    int          children;
+    WorkloadKind workloads[MAX_WORKLOADS];
+    int          workload_count;
+    long         transfers;
+    uint64_t     seed;
+    double       zipf_exponent;
+} ThroughputOptions;
+
+typedef struct {
+    const ThroughputOptions *options;
+    Workload                 workload;
+    uint64_t                 elapsed_ns;
+} ThroughputRun;
+
+static void closed_loop_workload(Process *parent, void *workload_arg) {
+    ThroughputRun *run = workload_arg;
+    int children = parent->num_process - 1;
+    balance_t available[MAX_PROCESS_ID + 1];
+    for (int id = 1; id <= children; id++) {
+        available[id] = CHILD_BALANCE;
+    }
+
+    uint64_t start_ns = bench_now_ns();
+    for (long i = 0; i < run->options->transfers; i++) {
+        local_id src, dst;
+        workload_next(&run->workload, &src, &dst);
+        balance_t amount = available[src] > 0 ? 1 : 0;
+        available[src] -= amount;
+        available[dst] += amount;
+        transfer(parent, src, dst, amount);
+    }
+    run->elapsed_ns = bench_now_ns() - start_ns;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: throughput_bench [-p children] [--workload uniform,zipf,ring,all-to-all]\n"
+                    "                        [--transfers K] [--seed S] [--zipf-s exponent]\n"
+                    "  transfers up to %d\n", BENCH_MAX_TRANSFERS);
+    exit(1);
+}
+
+static int parse_workloads(char *list, ThroughputOptions *options) {
+    options->workload_count = 0;
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        if (options->workload_count == MAX_WORKLOADS ||
+            workload_parse(name, &options->workloads[options->workload_count]) != 0) {
+            return -1;
+        }
+        options->workload_count++;
+    }
+    return options->workload_count > 0 ? 0 : -1;
+}
+
+static void parse_options(int argc, char *argv[], ThroughputOptions *options) {
+    options->children = 4;
+    for (int i = 0; i < MAX_WORKLOADS; i++) {
+        options->workloads[i] = i;
+    }
+    options->workload_count = MAX_WORKLOADS;
+    options->transfers = BENCH_MAX_TRANSFERS;
+    options->seed = 1;
+    options->zipf_exponent = 1.0;
+
+    for (int i = 1; i < argc; i++) {
+        char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            options->children = atoi(value);
+        } else if (strcmp(argv[i], "--workload") == 0) {
+            if (parse_workloads(value, options) != 0) {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--transfers") == 0) {
+            options->transfers = atol(value);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--zipf-s") == 0) {
+            options->zipf_exponent = atof(value);
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (options->children < 2 || options->children > MAX_PROCESS_ID || options->transfers <= 0 ||
+        options->transfers > BENCH_MAX_TRANSFERS || options->zipf_exponent < 0) {
+        usage();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    ThroughputOptions options;
+    parse_options(argc, argv, &options);
+
+    int balances[MAX_PROCESS_ID];
+    for (int id = 0; id < options.children; id++) {
+        balances[id] = CHILD_BALANCE;
+    }
+
+    for (int w = 0; w < options.workload_count; w++) {
+        ThroughputRun run;
+        memset(&run, 0, sizeof(run));
+        run.options = &options;
+        workload_init(&run.workload, options.workloads[w], options.children, options.seed, options.zipf_exponent);
+
+        RunResult result;
+        RunConfig config;
+        memset(&config, 0, sizeof(config));
+        config.num_processes = options.children + 1;
+        config.balances = balances;
+        config.workload = closed_loop_workload;
+        config.workload_arg = &run;
+        config.events_capacity = 4 * options.transfers + 4 * MAX_PROCESS_ID;
+        config.result = &result;
+        run_processes(&config);
+
+        double seconds = run.elapsed_ns / 1e9;
+        printf("{\"bench\":\"throughput\",\"workload\":\"%s\",\"children\":%d,\"transfers\":%ld,"
+               "\"seed\":%llu,\"zipf_s\":%.3f,\"elapsed_ns\":%llu,"
+               "\"transfers_per_sec\":%.1f,\"messages_per_sec\":%.1f,\"bytes_per_sec\":%.1f,"
+               "\"cpu_ns_per_transfer\":%.1f,\"total_cpu_ns\":%llu,\"total_messages\":%llu}\n",
+               workload_name(options.workloads[w]), options.children, options.transfers,
+               (unsigned long long) options.seed, options.zipf_exponent,
+               (unsigned long long) run.elapsed_ns,
+               options.transfers / seconds,
+               result.transfer_messages / seconds,
+               result.bytes / seconds,
+               (double) result.transfer_cpu_ns / options.transfers,
+               (unsigned long long) result.cpu_ns,
+               (unsigned long long) result.messages);
+        fflush(stdout);
+    }
+    return 0;
+}
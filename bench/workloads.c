@@ -0,0 +1,84 @@
+#include <math.h>
+#include <string.h>
+
+#include "workloads.h"
+
+static const char *const workload_names[] = {
+    [WORKLOAD_UNIFORM] = "uniform",
+    [WORKLOAD_ZIPF] = "zipf",
+    [WORKLOAD_RING] = "ring",
+    [WORKLOAD_ALL_TO_ALL] = "all-to-all",
+};
+
+int workload_parse(const char *name, WorkloadKind *kind) {
+    for (int i = 0; i < (int) (sizeof(workload_names) / sizeof(workload_names[0])); i++) {
+        if (strcmp(name, workload_names[i]) == 0) {
+            *kind = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *workload_name(WorkloadKind kind) {
+    return workload_names[kind];
+}
+
+void workload_init(Workload *workload, WorkloadKind kind, int children, uint64_t seed, double zipf_exponent) {
+    memset(workload, 0, sizeof(Workload));
+    workload->kind = kind;
+    workload->children = children;
+    rng_seed(&workload->rng, seed);
+
+    // account k (1-based rank) is picked with weight 1 / k^s
+    double total = 0;
+    for (int k = 0; k < children; k++) {
+        total += 1.0 / pow(k + 1, zipf_exponent);
+        workload->zipf_cdf[k] = total;
+    }
+    for (int k = 0; k < children; k++) {
+        workload->zipf_cdf[k] /= total;
+    }
+}
+
+static local_id zipf_pick(Workload *workload) {
+    double u = rng_uniform(&workload->rng);
+    int k = 0;
+    while (k < workload->children - 1 && workload->zipf_cdf[k] <= u) {
+        k++;
+    }
+    return 1 + k;
+}
+
+void workload_next(Workload *workload, local_id *src, local_id *dst) {
+    int children = workload->children;
+    long step = workload->step++;
+    switch (workload->kind) {
+        case WORKLOAD_UNIFORM:
+            *src = 1 + rng_below(&workload->rng, children);
+            *dst = 1 + rng_below(&workload->rng, children - 1);
+            if (*dst >= *src) {
+                (*dst)++;
+            }
+            break;
+        case WORKLOAD_ZIPF:
+            *src = zipf_pick(workload);
+            do {
+                *dst = zipf_pick(workload);
+            } while (*dst == *src);
+            break;
+        case WORKLOAD_RING:
+            *src = 1 + step % children;
+            *dst = 1 + (step + 1) % children;
+            break;
+        case WORKLOAD_ALL_TO_ALL: {
+            long pair = step % (children * (children - 1));
+            *src = 1 + pair / (children - 1);
+            *dst = 1 + pair % (children - 1);
+            if (*dst >= *src) {
+                (*dst)++;
+            }
+            break;
+        }
+    }
+}
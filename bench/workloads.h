@@ -0,0 +1,36 @@
+#ifndef WORKLOADS_H
+#define WORKLOADS_H
+
+#include "../ipc.h"
+#include "bench_rng.h"
+
+/**
+ * Transfer pattern generators shared by the benchmarks. A generator only
+ * picks (src, dst) pairs among the children 1..children; it is deterministic
+ * for a given seed.
+ */
+typedef enum {
+    WORKLOAD_UNIFORM,       ///< independent uniform pairs
+    WORKLOAD_ZIPF,          ///< src and dst drawn from a Zipf distribution over accounts
+    WORKLOAD_RING,          ///< 1->2, 2->3, ..., N->1 and around again
+    WORKLOAD_ALL_TO_ALL     ///< every ordered pair in turn
+} WorkloadKind;
+
+typedef struct {
+    WorkloadKind kind;
+    int          children;
+    BenchRng     rng;
+    double       zipf_cdf[MAX_PROCESS_ID];
+    long         step;
+} Workload;
+
+/// Returns -1 for an unknown name.
+int workload_parse(const char *name, WorkloadKind *kind);
+
+const char *workload_name(WorkloadKind kind);
+
+void workload_init(Workload *workload, WorkloadKind kind, int children, uint64_t seed, double zipf_exponent);
+
+void workload_next(Workload *workload, local_id *src, local_id *dst);
+
+#endif
@@ -0,0 +1,110 @@
+#include "event_log.h"
+#include "shared_log.h"
+#include "pa2345.h"
+#include "log.h"
+#include <string.h>
+
+
+static EventRecord ring[EVLOG_RING_SIZE];
+static uint32_t ring_head = 0;
+static uint32_t ring_tail = 0;
+
+static SharedLog* events_shared = NULL;
+
+void evlog_init(SharedLog* shared) {
+    events_shared = shared;
+    ring_head = 0;
+    ring_tail = 0;
+}
+
+static EventRecord* reserve_record(void) {
+    if (ring_head - ring_tail == EVLOG_RING_SIZE) {
+        evlog_flush();
+    }
+    return &ring[ring_head & (EVLOG_RING_SIZE - 1)];
+}
+
+void evlog_push(EventType type, local_id id, local_id peer, timestamp_t time, balance_t amount) {
+    EventRecord* record = reserve_record();
+    record->e_type = type;
+    record->e_id = id;
+    record->e_peer = peer;
+    record->e_time = time;
+    record->e_amount = amount;
+    record->e_pid = 0;
+    record->e_ppid = 0;
+    ring_head++;
+}
+
+void evlog_push_started(local_id id, timestamp_t time, balance_t balance, int32_t pid, int32_t ppid) {
+    EventRecord* record = reserve_record();
+    record->e_type = EV_STARTED;
+    record->e_id = id;
+    record->e_peer = 0;
+    record->e_time = time;
+    record->e_amount = balance;
+    record->e_pid = pid;
+    record->e_ppid = ppid;
+    ring_head++;
+}
+
+int evlog_format(const EventRecord* record, char* buffer, size_t buffer_len) {
+    switch (record->e_type) {
+        case EV_STARTED:
+            return snprintf(buffer, buffer_len, log_started_fmt, record->e_time, record->e_id,
+                            record->e_pid, record->e_ppid, record->e_amount);
+        case EV_RECEIVED_ALL_STARTED:
+            return snprintf(buffer, buffer_len, log_received_all_started_fmt, record->e_time, record->e_id);
+        case EV_TRANSFER_OUT:
+            return snprintf(buffer, buffer_len, log_transfer_out_fmt, record->e_time, record->e_id,
+                            record->e_amount, record->e_peer);
+        case EV_TRANSFER_IN:
+            return snprintf(buffer, buffer_len, log_transfer_in_fmt, record->e_time, record->e_id,
+                            record->e_amount, record->e_peer);
+        case EV_DONE:
+            return snprintf(buffer, buffer_len, log_done_fmt, record->e_time, record->e_id, record->e_amount);
+        case EV_RECEIVED_ALL_DONE:
+            return snprintf(buffer, buffer_len, log_received_all_done_fmt, record->e_time, record->e_id);
+        default:
+            return -1;
+    }
+}
+
+static void append_shared_records(uint32_t from, uint32_t to) {
+    if (events_shared == NULL) {
+        return;
+    }
+    uint32_t first = from & (EVLOG_RING_SIZE - 1);
+    uint32_t count = to - from;
+    uint32_t contiguous = EVLOG_RING_SIZE - first;
+    if (count <= contiguous) {
+        shared_log_append(events_shared, &ring[first], count);
+        return;
+    }
+    shared_log_append(events_shared, &ring[first], contiguous);
+    shared_log_append(events_shared, &ring[0], count - contiguous);
+}
+
+void evlog_flush(void) {
+    if (ring_head == ring_tail) {
+        return;
+    }
+#if LOG_ENABLED(PA_LOG_EVENT)
+    char line[EVLOG_LINE_MAX];
+    for (uint32_t idx = ring_tail; idx != ring_head; idx++) {
+        int len = evlog_format(&ring[idx & (EVLOG_RING_SIZE - 1)], line, sizeof(line));
+        if (len > 0) {
+            fwrite(line, 1, len, stdout);
+        }
+    }
+    fflush(stdout);
+#endif
+    append_shared_records(ring_tail, ring_head);
+    ring_tail = ring_head;
+}
+
+void evlog_idle(void) {
+    if (ring_head != ring_tail) {
+        evlog_flush();
+    }
+}
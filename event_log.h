@@ -0,0 +1,52 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "banking.h"
+
+typedef enum {
+    EV_STARTED = 0,
+    EV_RECEIVED_ALL_STARTED,
+    EV_TRANSFER_OUT,
+    EV_TRANSFER_IN,
+    EV_DONE,
+    EV_RECEIVED_ALL_DONE
+} EventType;
+
+/**
+ * Fixed-size binary record of one events.log line. Only raw values are
+ * stored on the hot path, the text of pa2345.h formats is produced on drain
+ * or by tools/evlog_fmt and tools/evlog_merge from the shared log file.
+ */
+typedef struct {
+    uint8_t     e_type;
+    local_id    e_id;       ///< process that logs the event
+    local_id    e_peer;     ///< other side of a transfer, otherwise 0
+    timestamp_t e_time;     ///< Lamport time of the event
+    balance_t   e_amount;   ///< transfer amount or current balance
+    int32_t     e_pid;      ///< STARTED only
+    int32_t     e_ppid;     ///< STARTED only
+} __attribute__((packed)) EventRecord;
+
+enum {
+    EVLOG_RING_SIZE = 256,  ///< must be a power of two
+    EVLOG_LINE_MAX = 128
+};
+
+struct SharedLog;
+
+void evlog_init(struct SharedLog* shared);
+
+void evlog_push(EventType type, local_id id, local_id peer, timestamp_t time, balance_t amount);
+
+void evlog_push_started(local_id id, timestamp_t time, balance_t balance, int32_t pid, int32_t ppid);
+
+void evlog_flush(void);
+
+void evlog_idle(void);
+
+int evlog_format(const EventRecord* record, char* buffer, size_t buffer_len);
+
+#endif
@@ -0,0 +1,48 @@
+#include "flow_control.h"
+#include "message_flags.h"
+
+
+static size_t in_flight[MAX_PROCESS_ID + 1];
+
+void flow_reset(void) {
+    for (int id = 0; id <= MAX_PROCESS_ID; id++) {
+        in_flight[id] = 0;
+    }
+}
+
+size_t flow_transfer_frame_len(uint16_t tail_len) {
+    return sizeof(MessageHeader) + sizeof(TransferOrder) + tail_len;
+}
+
+/// The simulator runs more children than a pipe mesh has; theirs are not accounted.
+void flow_on_transfer_sent(local_id src, const MessageFrame* transfer) {
+    if (src < 0 || src > MAX_PROCESS_ID) {
+        return;
+    }
+    in_flight[src] += sizeof(MessageHeader) + transfer->s_header.s_payload_len;
+}
+
+int flow_has_credit(local_id src, size_t frame_len) {
+    if (src < 0 || src > MAX_PROCESS_ID) {
+        return 1;
+    }
+    return in_flight[src] == 0 || in_flight[src] + frame_len <= FLOW_CREDIT_BYTES;
+}
+
+void flow_grant(MessageFrame* ack, local_id src) {
+    ack->s_payload[ack->s_header.s_payload_len++] = src;
+    ack->s_header.s_type |= MESSAGE_CREDIT_FLAG;
+}
+
+void flow_on_receive(Message* message) {
+    if (!(message->s_header.s_type & MESSAGE_CREDIT_FLAG) || message->s_header.s_payload_len == 0) {
+        return;
+    }
+    local_id src = message->s_payload[--message->s_header.s_payload_len];
+    message->s_header.s_type &= ~MESSAGE_CREDIT_FLAG;
+    if (src < 0 || src > MAX_PROCESS_ID) {
+        return;
+    }
+    size_t frame_len = flow_transfer_frame_len(message->s_header.s_payload_len);
+    in_flight[src] = in_flight[src] > frame_len ? in_flight[src] - frame_len : 0;
+}
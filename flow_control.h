@@ -0,0 +1,34 @@
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+#include <stddef.h>
+
+#include "banking.h"
+#include "message_pool.h"
+
+/**
+ * Credit-based flow control of the parent's TRANSFERs. Each child grants
+ * the parent FLOW_CREDIT_BYTES of TRANSFER frames in flight, half of a
+ * pipe buffer, so a slow child cannot make the parent's outbound queue
+ * grow without bound. The destination of a transfer returns the credit
+ * by piggybacking on its ACK: it sets MESSAGE_CREDIT_FLAG and appends the
+ * source id as the last payload byte, flow_on_receive() strips both.
+ */
+enum {
+    FLOW_CREDIT_BYTES = 32 * 1024
+};
+
+void flow_reset(void);
+
+void flow_on_transfer_sent(local_id src, const MessageFrame* transfer);
+
+/// A frame larger than the whole budget is allowed once nothing is in flight.
+int flow_has_credit(local_id src, size_t frame_len);
+
+size_t flow_transfer_frame_len(uint16_t tail_len);
+
+void flow_grant(MessageFrame* ack, local_id src);
+
+void flow_on_receive(Message* message);
+
+#endif
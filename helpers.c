@@ -1,14 +1,42 @@
+#define _GNU_SOURCE
+
 #include "helpers.h"
 #include "pipes_helper.h"
+#include "event_log.h"
+#include "log.h"
+#include "profiler.h"
+#include "tracepoints.h"
+#include "live_stats.h"
+#include "multicast_tree.h"
+#include "shm_barrier.h"
+#include "liveness.h"
+#include "message_pool.h"
+#include "flow_control.h"
+#include "mutex.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 
 
 static timestamp_t lamport_time = 0;
 
+enum {
+    DEFERRED_MAX = 32
+};
+
+/*
+ * Messages that arrived while a child was still collecting STARTED through
+ * receive_any() (tree multicast) or waiting for the lock in request_cs(),
+ * handed to ops_commands() first.
+ */
+static Message deferred[DEFERRED_MAX];
+static int deferred_head = 0;
+static int deferred_count = 0;
+
 const int FLAG = 1;
 
-void handle_stop(Process *process, FILE* event_file_ptr, int *is_stopped) {
+void handle_stop(Process *process, int *is_stopped) {
+    profiler_enter(PHASE_SHUTDOWN);
     (*is_stopped)++;
     if (*is_stopped > 1) {
         fprintf(stderr, "Error: Process %d received multiple STOP signals\n", process->pid);
@@ -21,8 +49,8 @@ void handle_stop(Process *process, FILE* event_file_ptr, int *is_stopped) {
         exit(1);
     }
 
-    printf(log_done_fmt, get_lamport_time(), process->pid, process->cur_balance);
-    fprintf(event_file_ptr, log_done_fmt, get_lamport_time(), process->pid, process->cur_balance);
+    evlog_push(EV_DONE, process->pid, 0, get_lamport_time(), process->cur_balance);
+    evlog_flush();
 }
 
 timestamp_t get_lamport_time(void) {
@@ -34,11 +62,10 @@ void check_state() {
     (void)x;
 }
 
-void handle_outgoing_transfer(Process *process, FILE* event_file_ptr, Message *msg, TransferOrder *order, timestamp_t time) {
+void handle_outgoing_transfer(Process *process, Message *msg, TransferOrder *order, timestamp_t time) {
     process->cur_balance -= order->s_amount;
     update_chronicle(&(process->history), time, process->cur_balance, order->s_amount);
-    fprintf(event_file_ptr, log_transfer_out_fmt, time, order->s_src, order->s_amount, order->s_dst);
-    printf(log_transfer_out_fmt, time, order->s_src, order->s_amount, order->s_dst);
+    evlog_push(EV_TRANSFER_OUT, order->s_src, order->s_dst, time, order->s_amount);
 
     msg->s_header.s_local_time = time;
     if (send(process, order->s_dst, msg) == -1) {
@@ -51,13 +78,12 @@ timestamp_t lmprd_time_upgrade(void) {
     return lamport_time;
 }
 
-void handle_incoming_transfer(Process *process, FILE* event_file_ptr, TransferOrder *order) {
+void handle_incoming_transfer(Process *process, Message *msg, TransferOrder *order) {
     process->cur_balance += order->s_amount;
     update_chronicle(&(process->history), get_lamport_time(), process->cur_balance, 0);
-    fprintf(event_file_ptr, log_transfer_in_fmt, get_lamport_time(), order->s_dst, order->s_amount, order->s_src);
-    printf(log_transfer_in_fmt, get_lamport_time(), order->s_dst, order->s_amount, order->s_src);
+    evlog_push(EV_TRANSFER_IN, order->s_dst, order->s_src, get_lamport_time(), order->s_amount);
     lmprd_time_upgrade();
-    if (mess_to(process, ACK, NULL) == -1) {
+    if (mess_ack_to(process, msg) == -1) {
         fprintf(stderr, "Error sending ACK from process %d to process %d\n", process->pid, order->s_src);
     }
 }
@@ -70,19 +96,26 @@ void lmprd_time_update(timestamp_t received_time) {
     lamport_time += 1; 
 }
 
-void handle_transfer(Process *process, FILE* event_file_ptr, Message *msg, TransferOrder *order) {
-    printf("Order src number is %d WHILE PROCESS PID is %d\n", order->s_src, process->pid);
+void lmprd_time_set(timestamp_t time) {
+    lamport_time = time;
+}
+
+void handle_transfer(Process *process, Message *msg, TransferOrder *order) {
+    LOG_DEBUG("Order src number is %d WHILE PROCESS PID is %d\n", order->s_src, process->pid);
+    TRACE_HANDLE_TRANSFER(get_lamport_time(), order->s_src, order->s_dst, order->s_amount, process->pid);
 
     if (order->s_src == process->pid) {
         if (process->cur_balance < order->s_amount) {
-            fprintf(stderr, "Insufficient funds for transfer by process %d\n", process->pid);
-            return;
+            // dropping the order would leave the parent waiting for an ACK that never comes
+            fprintf(stderr, "Error: insufficient funds for a transfer of $%d by process %d\n",
+                    order->s_amount, process->pid);
+            exit(1);
         }
 
         timestamp_t time = lmprd_time_upgrade();
-        handle_outgoing_transfer(process, event_file_ptr, msg, order, time);
+        handle_outgoing_transfer(process, msg, order, time);
     } else {
-        handle_incoming_transfer(process, event_file_ptr, order);
+        handle_incoming_transfer(process, msg, order);
     }
 }
 
@@ -90,20 +123,40 @@ void handle_done(Process *process, int *count_done) {
     (*count_done)++;
 }
 
-void handle_message(Process *process, FILE* event_file_ptr, Message *msg, int *count_done, int *is_stopped) {
+void await_done_barrier(Process *process, int *count_done) {
+    if (is_every_get(process, DONE) != 0) {
+        fprintf(stderr, "Error: Process %d failed to wait for DONE\n", process->pid);
+        exit(1);
+    }
+    *count_done = process->num_process - 2;
+}
+
+void handle_message(Process *process, Message *msg, int *count_done, int *is_stopped) {
     switch (msg->s_header.s_type) {
         case TRANSFER:
-            handle_transfer(process, event_file_ptr, msg, (TransferOrder *) msg->s_payload);
+            handle_transfer(process, msg, (TransferOrder *) msg->s_payload);
             break;
 
         case STOP:
-            handle_stop(process, event_file_ptr, is_stopped);
+            handle_stop(process, is_stopped);
+            if (shm_barrier != NULL) {
+                await_done_barrier(process, count_done);
+            }
             break;
 
         case DONE:
             handle_done(process, count_done);
             break;
 
+        case CS_REQUEST:
+        case CS_REPLY:
+        case CS_RELEASE:
+        case CS_TOKEN:
+            if (mutex_on_message(process, msg) != 0) {
+                exit(1);
+            }
+            break;
+
         default:
             fprintf(stderr, "Warning: Process %d received an unknown message type\n", process->pid);
             break;
@@ -111,125 +164,55 @@ void handle_message(Process *process, FILE* event_file_ptr, Message *msg, int *c
 }
 
 
-void get_history_from_process(Process* processes, local_id idx, BalanceHistory *received_history) {
-    Message received_msg;
-
-    if (receive(processes, idx + 1, &received_msg) != 0) {
+void get_history_from_process(Process* processes, local_id idx, Message *received_msg, BalanceHistory *received_history) {
+    if (receive(processes, idx + 1, received_msg) != 0) {
         fprintf(stderr, "Error: Unable to retrieve history from process %d. Possible communication issue.\n", idx + 1);
         exit(EXIT_FAILURE);
     }
-    memcpy(received_history, received_msg.s_payload, received_msg.s_header.s_payload_len);
+    memcpy(received_history, received_msg->s_payload, received_msg->s_header.s_payload_len);
 }
 
 void collect_histories(Process* processes, AllHistory* collection) {
-    local_id idx = 0;
-
-    while (idx < processes->num_process - 1) {
-        BalanceHistory received_history;
-        get_history_from_process(processes, idx, &received_history);
-
-        collection->s_history[idx] = received_history;
-        idx++;
+    Message* received_msg = message_pool_get();
+    if (received_msg == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    for (local_id idx = 0; idx < processes->num_process - 1; idx++) {
+        get_history_from_process(processes, idx, received_msg, &collection->s_history[idx]);
     }
+    message_pool_put(received_msg);
 }
 
-void chronicle(Process* processes) {
+void chronicle(Process* processes, int print) {
     AllHistory collection;
     collection.s_history_len = processes->num_process - 1;
     collect_histories(processes, &collection);
-    print_history(&collection);
-}
-
-
-void close_full_pipe(Pipe* pipe, FILE* pipe_file_ptr, int i, int j) {
-    close(pipe->fd[READ]);
-    close(pipe->fd[WRITE]);
-    fprintf(pipe_file_ptr, "Closed full pipe from %d to %d, write fd: %d, read fd: %d.\n",
-            i, j, pipe->fd[WRITE], pipe->fd[READ]);
-}
-
-void close_read_end(Pipe* pipe, FILE* pipe_file_ptr, int i, int j) {
-    close(pipe->fd[READ]);
-    fprintf(pipe_file_ptr, "Closed read end from %d to %d, read fd: %d.\n",
-            i, j, pipe->fd[READ]);
-}
-
-void close_write_end(Pipe* pipe, FILE* pipe_file_ptr, int i, int j) {
-    close(pipe->fd[WRITE]);
-    fprintf(pipe_file_ptr, "Closed write end from %d to %d, write fd: %d.\n",
-            i, j, pipe->fd[WRITE]);
-}
-
-void close_full_pipe2(Pipe* pipe, FILE* pipe_file_ptr, int i, int j) {
-    close(pipe->fd[READ]);
-    close(pipe->fd[WRITE]);
-    fprintf(pipe_file_ptr, "Closed pipe between process %d and %d\n", i, j);
-}
-
-void close_read_end2(Pipe* pipe, FILE* pipe_file_ptr, int i, int j) {
-    close(pipe->fd[READ]);
-    fprintf(pipe_file_ptr, "Closed read end of pipe between process %d and %d\n", i, j);
-}
-
-void close_write_end2(Pipe* pipe, FILE* pipe_file_ptr, int i, int j) {
-    close(pipe->fd[WRITE]);
-    fprintf(pipe_file_ptr, "Closed write end of pipe between process %d and %d\n", i, j);
-}
-
-void handle_pipe_closing(Process* pipes, FILE* pipe_file_ptr, int i, int j) {
-    if (i != pipes->pid && j != pipes->pid) {
-        if (1){
-            check_state();
-        }
-        close_full_pipe2(&pipes->pipes[i][j], pipe_file_ptr, i, j);
-    }
-    else if (i == pipes->pid && j != pipes->pid) {
-        close_read_end2(&pipes->pipes[i][j], pipe_file_ptr, i, j);
-    }
-    else if (j == pipes->pid && i != pipes->pid) {
-        if (1) check_state();
-        close_write_end2(&pipes->pipes[i][j], pipe_file_ptr, i, j);
+    if (print) {
+        print_history(&collection);
     }
 }
 
 
-void close_pipes_for_process(Process* pipes, FILE* pipe_file_ptr, int i, int n) {
-    for (int j = 0; j < n; j++) {
-        if (i != j) {
-            handle_pipe_closing(pipes, pipe_file_ptr, i, j);
-        }
+void close_fd_range(int first, int last) {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, first, last, 0) == 0) {
+        return;
+    }
+#endif
+    for (int fd = first; fd <= last; fd++) {
+        close(fd);
     }
-}
-
-void close_pipe(int read_fd, int write_fd) {
-    close(read_fd);
-    close(write_fd);
-}
-
-void log_pipe_closure(FILE* pipe_file_ptr, int pid, int target, int read_fd, int write_fd) {
-    fprintf(pipe_file_ptr, "Closed outgoing pipe from %d to %d, write fd: %d, read fd: %d.\n",
-            pid, target, write_fd, read_fd);
 }
 
 void drop_pipes_that_out(Process* processes, FILE* pipe_file_ptr) {
-    if (1){
-        check_state();
-    }
     int pid = processes->pid;
-    if (1) check_state();
     for (int target = 0; target < processes->num_process; target++) {
-        if (1) check_state();
         if (target == pid){
             continue;
         }
-        if (1){
-            check_state();
-        }
-        close_pipe(processes->pipes[pid][target].fd[READ], processes->pipes[pid][target].fd[WRITE]);
-        log_pipe_closure(pipe_file_ptr, pid, target,
-                         processes->pipes[pid][target].fd[READ], processes->pipes[pid][target].fd[WRITE]);
-        if (1) check_state();
+        close(processes->channels[target].c_write_fd);
     }
+    fprintf(pipe_file_ptr, "Process %d closed its %ld outgoing pipes\n", pid, processes->num_process - 1);
 }
 
 
@@ -240,28 +223,123 @@ int is_all_done(Process *process, int count_done, int *is_stopped) {
     return 0;
 }
 
-void add_history_and_log(Process *process, FILE* event_file_ptr) {
+void add_history_and_log(Process *process) {
+    profiler_enter(PHASE_HISTORY);
     update_chronicle(&(process->history), get_lamport_time(), process->cur_balance, 0);
-    printf(log_received_all_done_fmt, get_lamport_time(), process->pid);
-    fprintf(event_file_ptr, log_received_all_done_fmt, get_lamport_time(), process->pid);
+    evlog_push(EV_RECEIVED_ALL_DONE, process->pid, 0, get_lamport_time(), 0);
+    evlog_flush();
     lmprd_time_upgrade();
     mess_to(process, BALANCE_HISTORY, NULL);
 }
 
+int defer_message(const Message *msg) {
+    if (deferred_count == DEFERRED_MAX) {
+        fprintf(stderr, "Error: too many messages arrived before the barrier\n");
+        return -1;
+    }
+    message_copy(&deferred[(deferred_head + deferred_count++) % DEFERRED_MAX], msg);
+    return 0;
+}
+
+int deferred_pending(void) {
+    return deferred_count;
+}
+
+balance_t deferred_incoming(local_id pid) {
+    balance_t amount = 0;
+    for (int i = 0; i < deferred_count; i++) {
+        const Message *msg = &deferred[(deferred_head + i) % DEFERRED_MAX];
+        const TransferOrder *order = (const TransferOrder *) msg->s_payload;
+        if (msg->s_header.s_type == TRANSFER && order->s_dst == pid) {
+            amount += order->s_amount;
+        }
+    }
+    return amount;
+}
+
+int take_deferred(Message *msg) {
+    if (deferred_count == 0) {
+        return 0;
+    }
+    message_copy(msg, &deferred[deferred_head]);
+    deferred_head = (deferred_head + 1) % DEFERRED_MAX;
+    deferred_count--;
+    return 1;
+}
+
 int receive_message(Process *process, Message *msg) {
-    if (receive_any(process, msg) == -1) {
-        printf("Error receiving message at bank operations\n");
+    if (take_deferred(msg)) {
+        return 0;
+    }
+    if (receive_any(process, msg) != 0) {
+        fprintf(stderr, "Error receiving message at bank operations\n");
         return -1;
     }
     return 0;
 }
 
-void drop_pipes_that_non_rel(Process* pipes, FILE* pipe_file_ptr) {
-    int n = pipes->num_process;
+/// fds of the pipe matrix when create_pipes() got them as one run, -1 otherwise.
+static int matrix_first_fd = -1;
+static int matrix_last_fd = -1;
+
+static int compare_fds(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+/*
+ * The matrix is one run of fds, so everything in it that is not in the
+ * process' channel table lies in the gaps between its 2(N-1) sorted fds.
+ * Each gap goes to a single close_range(): O(N) work and syscalls per
+ * process, without looking at the rest of the matrix.
+ */
+void drop_pipes_that_non_rel(Process* process, FILE* pipe_file_ptr) {
+    int n = process->num_process;
+    int kept[2 * MAX_PROCESS_ID];
+    int kept_count = 0;
+    for (int peer = 0; peer < n; peer++) {
+        if (peer != process->pid) {
+            kept[kept_count++] = process->channels[peer].c_read_fd;
+            kept[kept_count++] = process->channels[peer].c_write_fd;
+        }
+    }
 
-    for (int i = 0; i < n; i++) {
-        close_pipes_for_process(pipes, pipe_file_ptr, i, n);
+    if (matrix_first_fd < 0) {
+        // some fd was already open inside the range, only the matrix itself can tell what to close
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (i == j) {
+                    continue;
+                }
+                if (j != process->pid) {
+                    close(process->pipes[i][j].fd[READ]);
+                }
+                if (i != process->pid) {
+                    close(process->pipes[i][j].fd[WRITE]);
+                }
+            }
+        }
+        fprintf(pipe_file_ptr, "Process %d kept %d channel fds, closed the others one by one\n",
+                process->pid, kept_count);
+        return;
+    }
+
+    qsort(kept, kept_count, sizeof(int), compare_fds);
+    int closed = 0;
+    int ranges = 0;
+    int next = matrix_first_fd;
+    for (int i = 0; i <= kept_count; i++) {
+        int last = i < kept_count ? kept[i] - 1 : matrix_last_fd;
+        if (last >= next) {
+            close_fd_range(next, last);
+            closed += last - next + 1;
+            ranges++;
+        }
+        if (i < kept_count) {
+            next = kept[i] + 1;
+        }
     }
+    fprintf(pipe_file_ptr, "Process %d kept %d channel fds, closed %d others in %d range(s)\n",
+            process->pid, kept_count, closed, ranges);
 }
 
 int check_if_all_done(Process *process, int count_done, int *is_stopped) {
@@ -279,37 +357,45 @@ void update_lamport_clock_from_message(int local_time) {
     lmprd_time_update(local_time);
 }
 
-void process_message_and_update_state(Process *process, FILE *event_file_ptr, Message *msg, int *count_done, int *is_stopped) {
-    handle_message(process, event_file_ptr, msg, count_done, is_stopped);
+void process_message_and_update_state(Process *process, Message *msg, int *count_done, int *is_stopped) {
+    handle_message(process, msg, count_done, is_stopped);
+}
+
+void log_event_and_history(Process *process) {
+    add_history_and_log(process);
+}
+
+void ops_state_init(OpsState *state) {
+    state->count_done = 0;
+    state->is_stopped = 0;
 }
 
-void log_event_and_history(Process *process, FILE *event_file_ptr) {
-    add_history_and_log(process, event_file_ptr);
+int ops_step(Process *process, OpsState *state, Message *msg) {
+    update_lamport_clock_from_message(msg->s_header.s_local_time);
+    LOG_DEBUG("%d\n", msg->s_header.s_type);
+    process_message_and_update_state(process, msg, &state->count_done, &state->is_stopped);
+    live_stats_tick(process, get_lamport_time());
+    if (check_if_all_done(process, state->count_done, &state->is_stopped)) {
+        log_event_and_history(process);
+        return 1;
+    }
+    return 0;
 }
 
-void ops_commands(Process *process, FILE* event_file_ptr) {
-    int count_done = 0;
-    int is_stopped = 0;
+void ops_commands(Process *process) {
+    OpsState state;
+    ops_state_init(&state);
     while(1) {
-        if (check_if_all_done(process, count_done, &is_stopped)) {
-            log_event_and_history(process, event_file_ptr);
-            return;
-        }
         Message msg;
         if (receive_message_from_process(process, &msg) == -1) {
             exit(1);
         }
-        update_lamport_clock_from_message(msg.s_header.s_local_time);
-        printf("%d\n", msg.s_header.s_type);
-        process_message_and_update_state(process, event_file_ptr, &msg, &count_done, &is_stopped);
+        if (ops_step(process, &state, &msg)) {
+            return;
+        }
     }
 }
 
-void log_pipe_closure2(FILE* pipe_file_ptr, int source, int pid, int read_fd, int write_fd) {
-    fprintf(pipe_file_ptr, "Closed incoming pipe from %d to %d, write fd: %d, read fd: %d.\n",
-            source, pid, write_fd, read_fd);
-}
-
 void drop_pipes_that_in(Process* processes, FILE* pipe_file_ptr) {
     int pid = processes->pid;
 
@@ -317,15 +403,23 @@ void drop_pipes_that_in(Process* processes, FILE* pipe_file_ptr) {
         if (source == pid){
             continue;
         }
-        close_pipe(processes->pipes[source][pid].fd[READ], processes->pipes[source][pid].fd[WRITE]);
-        log_pipe_closure2(pipe_file_ptr, source, pid,
-                          processes->pipes[source][pid].fd[READ], processes->pipes[source][pid].fd[WRITE]);
+        close(processes->channels[source].c_read_fd);
     }
+    fprintf(pipe_file_ptr, "Process %d closed its %ld incoming pipes\n", pid, processes->num_process - 1);
 }
 
 
-int send_started_message(Process* proc, Message* msg, timestamp_t current_time) {
-    int payload_size = snprintf(msg->s_payload, sizeof(msg->s_payload), log_started_fmt,
+/// STARTED and DONE go either to every peer or to the shared barrier.
+int announce_message(Process* proc, MessageFrame* msg) {
+    if (shm_barrier != NULL) {
+        shm_barrier_arrive(msg->s_header.s_type, msg->s_header.s_local_time);
+        return 0;
+    }
+    return send_multicast_frame(proc, msg);
+}
+
+int send_started_message(Process* proc, MessageFrame* msg, timestamp_t current_time) {
+    int payload_size = snprintf(msg->s_payload, MAX_PAYLOAD_LEN, log_started_fmt,
                                  current_time, proc->pid, getpid(), getppid(), proc->cur_balance);
     msg->s_header.s_payload_len = payload_size;
     if (payload_size < 0) {
@@ -334,15 +428,15 @@ int send_started_message(Process* proc, Message* msg, timestamp_t current_time)
     }
 
     lmprd_time_upgrade();
-    if (send_multicast(proc, msg) != 0) {
+    if (announce_message(proc, msg) != 0) {
         fprintf(stderr, "[ERROR] Failed to multicast STARTED message from process %d.\n", proc->pid);
         return -1;
     }
     return 0;
 }
 
-int send_done_message(Process* proc, Message* msg, timestamp_t current_time) {
-    int payload_size = snprintf(msg->s_payload, sizeof(msg->s_payload), log_done_fmt,
+int send_done_message(Process* proc, MessageFrame* msg, timestamp_t current_time) {
+    int payload_size = snprintf(msg->s_payload, MAX_PAYLOAD_LEN, log_done_fmt,
                                  current_time, proc->pid, proc->cur_balance);
     msg->s_header.s_payload_len = payload_size;
     if (payload_size < 0) {
@@ -351,7 +445,7 @@ int send_done_message(Process* proc, Message* msg, timestamp_t current_time) {
     }
 
     lmprd_time_upgrade();
-    if (send_multicast(proc, msg) != 0) {
+    if (announce_message(proc, msg) != 0) {
         fprintf(stderr, "[ERROR] Failed to multicast DONE message from process %d.\n", proc->pid);
         return -1;
     }
@@ -366,22 +460,25 @@ int validate_transfer_order(TransferOrder* transfer_order) {
     return 0;
 }
 
-void prepare_message(Message* msg, TransferOrder* transfer_order) {
+void prepare_message(MessageFrame* msg, TransferOrder* transfer_order) {
     msg->s_header.s_payload_len = sizeof(TransferOrder);
     memcpy(msg->s_payload, transfer_order, sizeof(TransferOrder));
     lmprd_time_upgrade();
 }
 
-int send_transfer_from_proc(Process* proc, TransferOrder* transfer_order, Message* msg) {
-    if (send(proc, transfer_order->s_src, msg) != 0) {
+int send_transfer_from_proc(Process* proc, TransferOrder* transfer_order, MessageFrame* msg) {
+    if (send_frame(proc, transfer_order->s_src, msg) != 0) {
         fprintf(stderr, "[ERROR] Failed to send TRANSFER message from process %d to process %d.\n",
                 proc->pid, transfer_order->s_src);
         return -1;
     }
+    if (proc->pid == PARENT_ID) {
+        flow_on_transfer_sent(transfer_order->s_src, msg);
+    }
     return 0;
 }
 
-int send_transfer_message2(Process* proc, Message* msg, TransferOrder* transfer_order) {
+int send_transfer_message2(Process* proc, MessageFrame* msg, TransferOrder* transfer_order) {
     int validation_result = validate_transfer_order(transfer_order);
     if (validation_result != 0) {
         return validation_result;
@@ -392,36 +489,47 @@ int send_transfer_message2(Process* proc, Message* msg, TransferOrder* transfer_
     return send_transfer_from_proc(proc, transfer_order, msg);
 }
 
-int send_stop_message(Process* proc, Message* msg) {
+int send_stop_message(Process* proc, MessageFrame* msg) {
     lmprd_time_upgrade();
-    if (send_multicast(proc, msg) != 0) {
+    if (send_multicast_frame(proc, msg) != 0) {
         fprintf(stderr, "[ERROR] Failed to multicast STOP message from process %d.\n", proc->pid);
         return -1;
     }
     return 0;
 }
 
-int send_ack_message(Process* proc, Message* msg) {
-    if (send(proc, 0, msg) != 0) {
+int send_ack_message(Process* proc, MessageFrame* msg) {
+    if (send_frame(proc, 0, msg) != 0) {
         fprintf(stderr, "[ERROR] Failed to send ACK message from process %d to parent.\n", proc->pid);
         return -1;
     }
     return 0;
 }
 
-int send_balance_history_message(Process* proc, Message* msg) {
+int send_balance_history_message(Process* proc, MessageFrame* msg) {
     int payload_size = sizeof(proc->history.s_id) + sizeof(proc->history.s_history_len) +
                        sizeof(BalanceState) * proc->history.s_history_len;
     msg->s_header.s_payload_len = payload_size;
     memcpy(msg->s_payload, &(proc->history), payload_size);
 
-    if (send(proc, 0, msg) != 0) {
+    if (send_frame(proc, 0, msg) != 0) {
         fprintf(stderr, "[ERROR] Failed to send BALANCE_HISTORY message from process %d.\n", proc->pid);
         return -1;
     }
     return 0;
 }
 
+/// CS_REQUEST and CS_RELEASE go to every other child, the parent takes no part in the lock.
+int send_cs_message(Process* proc, MessageFrame* msg) {
+    for (local_id dst = 1; dst < proc->num_process; dst++) {
+        if (dst != proc->pid && send_frame(proc, dst, msg) != 0) {
+            fprintf(stderr, "[ERROR] Failed to send CS message from process %d to process %d.\n", proc->pid, dst);
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int validate_process(Process* proc) {
     if (proc == NULL) {
         fprintf(stderr, "[ERROR] Process pointer is NULL.\n");
@@ -431,21 +539,21 @@ int validate_process(Process* proc) {
 }
 
 int validate_message_type(MessageType msg_type) {
-    if (msg_type < STARTED || msg_type > BALANCE_HISTORY) {
+    if (msg_type < STARTED || msg_type > CS_RELEASE) {
         fprintf(stderr, "[ERROR] Invalid message type: %d\n", msg_type);
         return -1;
     }
     return 0;
 }
 
-void initialize_message(Message* msg, MessageType msg_type, timestamp_t current_time) {
+void initialize_message(MessageFrame* msg, MessageType msg_type, timestamp_t current_time) {
     msg->s_header.s_local_time = current_time;
     msg->s_header.s_magic = MESSAGE_MAGIC;
     msg->s_header.s_type = msg_type;
     msg->s_header.s_payload_len = 0;
 }
 
-int send_message_of_type(Process* proc, MessageType msg_type, Message* msg, TransferOrder* transfer_order) {
+int send_message_of_type(Process* proc, MessageType msg_type, MessageFrame* msg, TransferOrder* transfer_order) {
     switch (msg_type) {
         case STARTED:
             return send_started_message(proc, msg, msg->s_header.s_local_time);
@@ -459,12 +567,126 @@ int send_message_of_type(Process* proc, MessageType msg_type, Message* msg, Tran
             return send_ack_message(proc, msg);
         case BALANCE_HISTORY:
             return send_balance_history_message(proc, msg);
+        case CS_REQUEST:
+        case CS_RELEASE:
+            msg->s_header.s_payload_len = 1;
+            msg->s_payload[0] = proc->pid;
+            return send_cs_message(proc, msg);
         default:
             fprintf(stderr, "[WARNING] Invalid message type for process %d.\n", proc->pid);
         return -1;
     }
 }
 
+int mess_transfer_to(Process* proc, TransferOrder* transfer_order, const void* tail, uint16_t tail_len) {
+    int validation_result = validate_process(proc);
+    if (validation_result != 0) {
+        return validation_result;
+    }
+    if (tail_len > TRANSFER_TAIL_MAX) {
+        fprintf(stderr, "[ERROR] Transfer tail of %d bytes is too long.\n", tail_len);
+        return -1;
+    }
+
+    validation_result = validate_transfer_order(transfer_order);
+    if (validation_result != 0) {
+        return validation_result;
+    }
+
+    SmallMessage small;
+    MessageFrame* msg = message_acquire(&small, sizeof(TransferOrder) + tail_len);
+    if (msg == NULL) {
+        return -1;
+    }
+    timestamp_t current_time = lmprd_time_upgrade();
+    initialize_message(msg, TRANSFER, current_time);
+    prepare_message(msg, transfer_order);
+    memcpy(msg->s_payload + sizeof(TransferOrder), tail, tail_len);
+    msg->s_header.s_payload_len += tail_len;
+
+    int status = send_transfer_from_proc(proc, transfer_order, msg);
+    message_release(&small, msg);
+    return status;
+}
+
+int mess_ack_to(Process* proc, const Message* transfer_msg) {
+    int validation_result = validate_process(proc);
+    if (validation_result != 0) {
+        return validation_result;
+    }
+
+    uint16_t tail_len = 0;
+    if (transfer_msg->s_header.s_payload_len > sizeof(TransferOrder)) {
+        tail_len = transfer_msg->s_header.s_payload_len - sizeof(TransferOrder);
+    }
+    SmallMessage small;
+    MessageFrame* msg = message_acquire(&small, tail_len + 1);
+    if (msg == NULL) {
+        return -1;
+    }
+    timestamp_t current_time = lmprd_time_upgrade();
+    initialize_message(msg, ACK, current_time);
+    msg->s_header.s_payload_len = tail_len;
+    memcpy(msg->s_payload, transfer_msg->s_payload + sizeof(TransferOrder), tail_len);
+    flow_grant(msg, ((const TransferOrder*) transfer_msg->s_payload)->s_src);
+
+    int status = send_ack_message(proc, msg);
+    message_release(&small, msg);
+    return status;
+}
+
+/// Sender id first, receive_any() does not tell who sent a message.
+static MessageFrame* build_cs_message(Process* proc, SmallMessage* small, int16_t msg_type,
+                                      const void* body, uint16_t body_len) {
+    MessageFrame* msg = message_acquire(small, 1 + body_len);
+    if (msg == NULL) {
+        return NULL;
+    }
+    timestamp_t current_time = lmprd_time_upgrade();
+    initialize_message(msg, msg_type, current_time);
+    msg->s_header.s_payload_len = 1 + body_len;
+    msg->s_payload[0] = proc->pid;
+    if (body_len > 0) {
+        memcpy(msg->s_payload + 1, body, body_len);
+    }
+    return msg;
+}
+
+int mess_cs_to(Process* proc, int16_t msg_type, local_id dst, const void* body, uint16_t body_len) {
+    int validation_result = validate_process(proc);
+    if (validation_result != 0) {
+        return validation_result;
+    }
+
+    SmallMessage small;
+    MessageFrame* msg = build_cs_message(proc, &small, msg_type, body, body_len);
+    if (msg == NULL) {
+        return -1;
+    }
+    int status = send_frame(proc, dst, msg);
+    if (status != 0) {
+        fprintf(stderr, "[ERROR] Failed to send CS message from process %d to process %d.\n", proc->pid, dst);
+    }
+    message_release(&small, msg);
+    return status;
+}
+
+int mess_cs_multicast(Process* proc, int16_t msg_type, const void* body, uint16_t body_len) {
+    int validation_result = validate_process(proc);
+    if (validation_result != 0) {
+        return validation_result;
+    }
+
+    SmallMessage small;
+    MessageFrame* msg = build_cs_message(proc, &small, msg_type, body, body_len);
+    if (msg == NULL) {
+        return -1;
+    }
+    int status = send_cs_message(proc, msg);
+    message_release(&small, msg);
+    return status;
+}
+
 int mess_to(Process* proc, MessageType msg_type, TransferOrder* transfer_order) {
     int validation_result = validate_process(proc);
     if (validation_result != 0) {
@@ -476,11 +698,20 @@ int mess_to(Process* proc, MessageType msg_type, TransferOrder* transfer_order)
         return validation_result;
     }
 
-    Message msg;
+    // STOP, TRANSFER and the CS_* ones fit in a SmallMessage, the formatted ones and histories do not
+    size_t payload_max = (msg_type == STOP || msg_type == TRANSFER || msg_type >= CS_REQUEST)
+                         ? sizeof(TransferOrder) : MAX_PAYLOAD_LEN;
+    SmallMessage small;
+    MessageFrame* msg = message_acquire(&small, payload_max);
+    if (msg == NULL) {
+        return -1;
+    }
     timestamp_t current_time = lmprd_time_upgrade();
-    initialize_message(&msg, msg_type, current_time);
+    initialize_message(msg, msg_type, current_time);
 
-    return send_message_of_type(proc, msg_type, &msg, transfer_order);
+    int status = send_message_of_type(proc, msg_type, msg, transfer_order);
+    message_release(&small, msg);
+    return status;
 }
 
 
@@ -510,6 +741,11 @@ void add_new_state(BalanceHistory* record, timestamp_t current_time, balance_t c
 }
 
 void update_chronicle(BalanceHistory* record, timestamp_t current_time, balance_t cur_balance, balance_t delta) {
+    TRACE_UPDATE_CHRONICLE(current_time, record->s_id, cur_balance, delta);
+    if (current_time < 0 || current_time >= MAX_T) {
+        // BalanceHistory only covers t < MAX_T, long benchmark runs go past it
+        return;
+    }
     if (record->s_history_len > 0) {
         BalanceState last_state = record->s_history[record->s_history_len - 1];
         timestamp_t last_recorded_time = last_state.s_time;
@@ -522,8 +758,8 @@ void update_chronicle(BalanceHistory* record, timestamp_t current_time, balance_
 
 int handle_received_message(Process* process, int i, MessageType type, int* count) {
     Message msg;
-    if (receive(process, i, &msg) == -1) {
-        printf("Error while receiving messages\n");
+    if (receive(process, i, &msg) != 0) {
+        fprintf(stderr, "Error while receiving messages\n");
         return -1;
     }
     if (msg.s_header.s_type == type) {
@@ -565,27 +801,70 @@ int process_other_processes(Process* process, MessageType type, int *count) {
     return 0;
 }
 
+/// Row pointers and the N x N matrix share one allocation, released with a single free().
 Pipe** allocate_pipes(int process_count) {
     if (1) check_state();
-    Pipe** pipes = (Pipe**) malloc(process_count * sizeof(Pipe*));
-    if (1) check_state();
+    Pipe** pipes = (Pipe**) malloc(process_count * sizeof(Pipe*) + process_count * process_count * sizeof(Pipe));
+    if (pipes == NULL) {
+        perror("Failed to allocate the pipe matrix");
+        exit(EXIT_FAILURE);
+    }
+    Pipe* matrix = (Pipe*) (pipes + process_count);
     for (int i = 0; i < process_count; i++) {
-        pipes[i] = (Pipe*) malloc(process_count * sizeof(Pipe));
+        pipes[i] = matrix + i * process_count;
     }
     return pipes;
 }
 
-void create_pipe(Pipe* pipe_n) {
-    if (pipe(pipe_n->fd) != 0) {
-        perror("Pipe creation failed");
-        exit(EXIT_FAILURE);
+void bind_channels(Process* process) {
+    for (int peer = 0; peer < process->num_process; peer++) {
+        if (peer == process->pid) {
+            process->channels[peer] = (Channel) {.c_read_fd = -1, .c_write_fd = -1};
+            continue;
+        }
+        process->channels[peer] = (Channel) {
+            .c_read_fd = process->pipes[peer][process->pid].fd[READ],
+            .c_write_fd = process->pipes[process->pid][peer].fd[WRITE]
+        };
+    }
+}
+
+/// With tree multicast a peer's message may come through any channel.
+int collect_from_any(Process* process, MessageType type, int *count) {
+    while (*count < process->num_process - 2) {
+        Message msg;
+        if (receive_any(process, &msg) != 0) {
+            fprintf(stderr, "Error while receiving messages\n");
+            return -1;
+        }
+        if (msg.s_header.s_type != type) {
+            if (defer_message(&msg) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        lmprd_time_update(msg.s_header.s_local_time);
+        (*count)++;
     }
+    return 0;
 }
 
 int is_every_get(Process* process, MessageType type) {
     int count = 0;
 
-    int process_result = process_other_processes(process, type, &count);
+    if (shm_barrier != NULL && (type == STARTED || type == DONE)) {
+        timestamp_t latest = shm_barrier_wait(type, process->num_process - 1, process->pid,
+                                              liveness_deadline());
+        if (latest < 0) {
+            return -1;
+        }
+        lmprd_time_update(latest);
+        return 0;
+    }
+
+    int process_result = (mtree_fanout > 0 && process->pid != PARENT_ID)
+                         ? collect_from_any(process, type, &count)
+                         : process_other_processes(process, type, &count);
     if (process_result == -1) {
         return -1;
     }
@@ -594,25 +873,10 @@ int is_every_get(Process* process, MessageType type) {
 }
 
 
-void set_non_blocking(int fd) {
-    int flags = fcntl(fd, F_GETFL);
-    if (flags == -1) {
-        perror("Error retrieving flags for pipe");
-        exit(EXIT_FAILURE);
-    }
-    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-        perror("Failed to set non-blocking mode for pipe");
-        exit(EXIT_FAILURE);
-    }
-}
-
-void log_pipe(FILE* log_fp, int src, int dest, Pipe* pipe) {
-    fprintf(log_fp, "Pipe initialized: from process %d to process %d (write: %d, read: %d)\n",
-            src, dest, pipe->fd[WRITE], pipe->fd[READ]);
-}
-
 Pipe** create_pipes(int process_count, FILE* log_fp) {
     Pipe** pipes = allocate_pipes(process_count);
+    int first_fd = -1;
+    int last_fd = -1;
     for (int src = 0; src < process_count; src++) {
         if (1) check_state();
         for (int dest = 0; dest < process_count; dest++) {
@@ -620,12 +884,27 @@ Pipe** create_pipes(int process_count, FILE* log_fp) {
                 if (1) check_state();
                 continue;
             }
-            create_pipe(&pipes[src][dest]);
-            set_non_blocking(pipes[src][dest].fd[READ]);
-            set_non_blocking(pipes[src][dest].fd[WRITE]);
-            log_pipe(log_fp, src, dest, &pipes[src][dest]);
+            if (pipe2(pipes[src][dest].fd, O_NONBLOCK) != 0) {
+                perror("Pipe creation failed");
+                exit(EXIT_FAILURE);
+            }
+            for (int end = READ; end <= WRITE; end++) {
+                int fd = pipes[src][dest].fd[end];
+                first_fd = (first_fd < 0 || fd < first_fd) ? fd : first_fd;
+                last_fd = fd > last_fd ? fd : last_fd;
+            }
         }
     }
 
+    int pipe_count = process_count * (process_count - 1);
+    if (last_fd - first_fd + 1 == 2 * pipe_count) {
+        matrix_first_fd = first_fd;
+        matrix_last_fd = last_fd;
+    } else {
+        matrix_first_fd = -1;
+        matrix_last_fd = -1;
+    }
+    fprintf(log_fp, "Created %d pipes for %d processes, fds %d to %d\n",
+            pipe_count, process_count, first_fd, last_fd);
     return pipes;
 }
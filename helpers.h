@@ -11,23 +11,89 @@
 
 #include "pa2345.h"
 #include "base_vars.h"
+#include "message_pool.h"
 
 
 Pipe** create_pipes(int process_count, FILE* log_file_ptr);
 
+/// Copies the fds of process->pid out of the pipe matrix into its channel table.
+void bind_channels(Process* process);
+
 int mess_to(Process* proc, MessageType msg_type, TransferOrder* transfer_order);
 
 int is_every_get(Process* process, MessageType type);
 
 void update_chronicle(BalanceHistory* record, timestamp_t current_time, balance_t cur_balance, balance_t delta);
 
-void chronicle(Process* proc);
+void chronicle(Process* proc, int print);
+
+void ops_commands(Process *process);
+
+/*
+ * What a child remembers between two messages of ops_commands(), so the same
+ * handling can be driven one message at a time (see sim/pa_sim.c).
+ */
+typedef struct {
+    int count_done;
+    int is_stopped;
+} OpsState;
+
+void ops_state_init(OpsState *state);
+
+/// Handles one received message, returns 1 once the process has sent its history.
+int ops_step(Process *process, OpsState *state, Message *msg);
+
+/*
+ * A TRANSFER payload may carry an opaque tail after the TransferOrder, e.g.
+ * a benchmark sequence number. The destination echoes it back in the ACK.
+ */
+enum {
+    TRANSFER_TAIL_MAX = MAX_PAYLOAD_LEN - sizeof(TransferOrder)
+};
+
+int mess_transfer_to(Process* proc, TransferOrder* transfer_order, const void* tail, uint16_t tail_len);
+
+int mess_ack_to(Process* proc, const Message* transfer_msg);
+
+/// CS_* messages of mutex.h: the sender id, then body_len bytes of body.
+int mess_cs_to(Process* proc, int16_t msg_type, local_id dst, const void* body, uint16_t body_len);
+
+int mess_cs_multicast(Process* proc, int16_t msg_type, const void* body, uint16_t body_len);
+
+/// Ring of messages put aside for ops_commands() while a barrier or the lock is awaited.
+int defer_message(const Message *msg);
 
-void ops_commands(Process *process, FILE* event_file_ptr);
+int take_deferred(Message *msg);
+
+int deferred_pending(void);
+
+/// Money of the deferred TRANSFERs to pid, received but not applied to its balance yet.
+balance_t deferred_incoming(local_id pid);
+
+int try_receive_any(void *self, Message *msg);
+
+/// send() and send_multicast() of a frame that may be shorter than a Message.
+int send_frame(void *self, local_id dst, const MessageFrame *frame);
+
+int send_multicast_frame(void *self, const MessageFrame *frame);
+
+enum {
+    IPC_TIMEOUT = -5    ///< a deadline of the receive functions below has passed
+};
+
+/// receive() and receive_any() until deadline_ns of CLOCK_MONOTONIC, 0 for no deadline.
+int receive_until(void *self, local_id from, Message *msg, uint64_t deadline_ns);
+
+int receive_any_until(void *self, Message *msg, uint64_t deadline_ns);
+
+/// Blocks until some open channel is readable, without reading it.
+int wait_any_readable(void *self, uint64_t deadline_ns);
 
 timestamp_t lmprd_time_upgrade(void);
 
 void lmprd_time_update(timestamp_t received_time);
 
+void lmprd_time_set(timestamp_t time);
+
 
 #endif
@@ -1,15 +1,39 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "helpers.h"
 #include "base_vars.h"
+#include "event_log.h"
+#include "log.h"
+#include "ipc_stats.h"
+#include "tracepoints.h"
+#include "live_stats.h"
+#include "trace.h"
+#include "multicast_tree.h"
+#include "msg_slots.h"
+#include "out_queue.h"
+#include "flow_control.h"
+#include "snapshot.h"
+#include "liveness.h"
 #include <errno.h>
+#include <poll.h>
 #include <unistd.h>
 
 
+/// Outcomes of check(), the non-blocking read of a message header.
+enum {
+    CHECK_READY = 0,
+    CHECK_ERROR = 1,
+    CHECK_EMPTY = 2,
+    CHECK_CLOSED = 3    ///< EOF, the peer closed its end and everything it sent was read
+};
+
 int get_write_fd(Process *proc_ptr, local_id destination) {
-    return proc_ptr->pipes[proc_ptr->pid][destination].fd[WRITE];
+    return proc_ptr->channels[destination].c_write_fd;
 }
 
-ssize_t write_message(int write_fd, const Message *message) {
-    return write(write_fd, &(message->s_header), sizeof(MessageHeader) + message->s_header.s_payload_len);
+int write_message(int write_fd, local_id destination, const MessageFrame *frame) {
+    size_t frame_len = sizeof(MessageHeader) + frame->s_header.s_payload_len;
+    return out_queue_send(write_fd, destination, frame, frame_len);
 }
 
 const int FLAG_IPC = 1;
@@ -18,18 +42,26 @@ void handle_write_error(Process *proc_ptr, local_id destination) {
     fprintf(stderr, "Ошибка при записи из процесса %d в процесс %d\n", proc_ptr->pid, destination);
 }
 
-int send(void *context, local_id destination, const Message *message) {
+int send_frame(void *context, local_id destination, const MessageFrame *frame) {
     Process *proc_ptr = (Process *) context;
     int write_fd = get_write_fd(proc_ptr, destination);
+    TRACE_SEND_ENTRY(frame->s_header.s_local_time, proc_ptr->pid, destination, frame->s_header.s_type);
 
-    ssize_t bytes_written = write_message(write_fd, message);
-    if (bytes_written < 0) {
+    if (write_message(write_fd, destination, frame) < 0) {
         handle_write_error(proc_ptr, destination);
+        TRACE_SEND_RETURN(frame->s_header.s_local_time, proc_ptr->pid, destination, frame->s_header.s_type, -1);
         return -1;
     }
+    ipc_stats_on_send(destination, &frame->s_header);
+    trace_on_send(proc_ptr->pid, destination, frame);
+    TRACE_SEND_RETURN(frame->s_header.s_local_time, proc_ptr->pid, destination, frame->s_header.s_type, 0);
     return 0;
 }
 
+int send(void *context, local_id destination, const Message *message) {
+    return send_frame(context, destination, message_frame(message));
+}
+
 void check_state_ipc() {
     int x = FLAG_IPC;
     (void)x;
@@ -40,8 +72,8 @@ int should_skip_process(Process *proc_ptr, int idx) {
     return idx == proc_ptr->pid;
 }
 
-int send_message_to_process(Process *proc_ptr, const Message *message, int idx) {
-    if (send(proc_ptr, idx, message) < 0) {
+int send_message_to_process(Process *proc_ptr, const MessageFrame *frame, int idx) {
+    if (send_frame(proc_ptr, idx, frame) < 0) {
         return -1;
     }
     return 0;
@@ -55,26 +87,34 @@ int should_skip_process_if_needed(Process *proc_ptr, int idx) {
     return should_skip_process(proc_ptr, idx);
 }
 
-int send_message_to_target_process(Process *proc_ptr, const Message *message, int idx) {
-    return send_message_to_process(proc_ptr, message, idx);
+int send_message_to_target_process(Process *proc_ptr, const MessageFrame *frame, int idx) {
+    return send_message_to_process(proc_ptr, frame, idx);
 }
 
 void log_multicast_error_for_process(Process *proc_ptr, int idx) {
     log_multicast_error(proc_ptr, idx);
 }
 
-int send_multicast(void *context, const Message *message) {
+int send_multicast_frame(void *context, const MessageFrame *frame) {
     if (1) check_state_ipc();
     Process *proc_ptr = (Process *) context;
-    Process current_proc = *proc_ptr;
+    if (mtree_fanout > 0) {
+        return mtree_send(proc_ptr, frame);
+    }
+    if (msg_slots != NULL && frame->s_header.s_payload_len > sizeof(uint32_t)) {
+        int slot_status = msg_slots_multicast(proc_ptr, frame);
+        if (slot_status <= 0) {
+            return slot_status;
+        }
+    }
     if (1) check_state_ipc();
-    for (int idx = 0; idx < current_proc.num_process; idx++) {
-        if (should_skip_process_if_needed(&current_proc, idx)) {
+    for (int idx = 0; idx < proc_ptr->num_process; idx++) {
+        if (should_skip_process_if_needed(proc_ptr, idx)) {
             continue;
         }
         if (1) check_state_ipc();
-        if (send_message_to_target_process(&current_proc, message, idx) < 0) {
-            log_multicast_error_for_process(&current_proc, idx);
+        if (send_message_to_target_process(proc_ptr, frame, idx) < 0) {
+            log_multicast_error_for_process(proc_ptr, idx);
             if (1) check_state_ipc();
             return -1;
         }
@@ -82,8 +122,45 @@ int send_multicast(void *context, const Message *message) {
     return 0;
 }
 
+int send_multicast(void *context, const Message *message) {
+    return send_multicast_frame(context, message_frame(message));
+}
+
+/// The rest of a frame is on its way; keep our own queues moving while waiting for it.
+void wait_rest_of_frame(int fd_to_read) {
+    if (out_queue_flush() != 0) {
+        return;
+    }
+    struct pollfd readable = {.fd = fd_to_read, .events = POLLIN};
+    poll(&readable, 1, out_queue_pending() > 0 ? 1 : -1);
+}
+
+int read_header_rest(int fd_to_read, Message *message, size_t bytes_read) {
+    char *header = (char *) &(message->s_header);
+    while (bytes_read < sizeof(MessageHeader)) {
+        ssize_t result = read(fd_to_read, header + bytes_read, sizeof(MessageHeader) - bytes_read);
+        ipc_stats.syscalls++;
+        if (result < 0 && errno == EAGAIN) {
+            ipc_stats.eagain_spins++;
+            wait_rest_of_frame(fd_to_read);
+            continue;
+        }
+        if (result <= 0) {
+            fprintf(stderr, "Error: channel closed in the middle of a message header\n");
+            return 1;
+        }
+        bytes_read += result;
+    }
+    return 0;
+}
+
 ssize_t read_message_header(int fd_to_read, Message *message) {
-    return read(fd_to_read, &(message->s_header), sizeof(MessageHeader));
+    ssize_t read_status = read(fd_to_read, &(message->s_header), sizeof(MessageHeader));
+    ipc_stats.syscalls++;
+    if (read_status > 0 && (size_t) read_status < sizeof(MessageHeader)) {
+        ipc_stats.short_reads++;
+    }
+    return read_status;
 }
 
 int validate_message_pointer(Message *message) {
@@ -116,6 +193,7 @@ int handle_read_error(ssize_t read_status) {
     if (read_status == -1) {
         if (1) check_state_ipc();
         if (errno == EAGAIN) {
+            ipc_stats.eagain_spins++;
             return 2;
         } else {
             if (1) check_state_ipc();
@@ -127,8 +205,8 @@ int handle_read_error(ssize_t read_status) {
         check_state_ipc();
     }
     if (read_status == 0) {
-        fprintf(stderr, "Attention: end of file or no data\n");
-        return 2;
+        LOG_DEBUG("Attention: end of file\n");
+        return CHECK_CLOSED;
     }
     return 0;
 }
@@ -138,6 +216,9 @@ int check(int fd_to_read, Message *message) {
         return -1;
     }
     ssize_t read_status = read_message_header(fd_to_read, message);
+    if (read_status > 0 && (size_t) read_status < sizeof(MessageHeader)) {
+        return read_header_rest(fd_to_read, message, read_status);
+    }
     return handle_read_error(read_status);
 }
 
@@ -158,13 +239,19 @@ int validate_message_args(int fd, Message *msg_ptr) {
 }
 
 ssize_t read_payload(int fd, char *payload_buffer, size_t bytes_to_read) {
-    return read(fd, payload_buffer, bytes_to_read);
+    ssize_t result = read(fd, payload_buffer, bytes_to_read);
+    ipc_stats.syscalls++;
+    if (result > 0 && (size_t) result < bytes_to_read) {
+        ipc_stats.short_reads++;
+    }
+    return result;
 }
 
 int handle_read_error2(ssize_t result) {
     if (result < 0) {
         if (1) check_state_ipc();
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            ipc_stats.eagain_spins++;
             return 1;
         } else {
             if (1){
@@ -210,6 +297,11 @@ int read_data(int fd, char *payload_buffer, size_t payload_length, size_t *bytes
     while (*bytes_read < payload_length) {
         ssize_t result = read_payload(fd, payload_buffer + *bytes_read, payload_length - *bytes_read);
         int error_code = handle_read_error2(result);
+        if (error_code == 1) {
+            // the header is already consumed, the payload must follow
+            wait_rest_of_frame(fd);
+            continue;
+        }
         if (error_code != 0) {
             return error_code;
         }
@@ -260,19 +352,17 @@ int validate_receive_args(void *process_context, Message *msg_buffer) {
 }
 
 int get_read_descriptor(Process *proc_info, local_id sender_id) {
-    return proc_info->pipes[sender_id][proc_info->pid].fd[READ];
+    return proc_info->channels[sender_id].c_read_fd;
 }
 
 int check_availability(int read_descriptor, Message *msg_buffer) {
     int availability_status = check(read_descriptor, msg_buffer);
-    if (availability_status == 2) {
-        return 1;
-    }
-    if (availability_status != 0) {
-        fprintf(stderr, "Ошибка при попытке прочитать заголовок\n");
-        return 0;
+    if (availability_status == CHECK_READY || availability_status == CHECK_EMPTY ||
+        availability_status == CHECK_CLOSED) {
+        return availability_status;
     }
-    return 0;
+    fprintf(stderr, "Ошибка при попытке прочитать заголовок\n");
+    return -1;
 }
 
 int read_message_body(int read_descriptor, Message *msg_buffer) {
@@ -292,20 +382,71 @@ int get_read_descriptor_for_process(Process *proc_info, local_id sender_id) {
     return get_read_descriptor(proc_info, sender_id);
 }
 
-int wait_for_message_availability(int read_descriptor, Message *msg_buffer) {
+/*
+ * Blocks in poll() until one of fds is readable, in slices of
+ * LIVENESS_SLICE_MS so that a dead peer or a passed deadline is noticed.
+ * Our own outbound queues are flushed first, the peer we wait for may be
+ * waiting for them.
+ */
+int wait_readable(Process *proc_info, struct pollfd *fds, nfds_t count, uint64_t deadline_ns) {
     while (1) {
-        int availability_status = check_availability(read_descriptor, msg_buffer);
-        if (availability_status == 1) {
-            continue;
+        if (out_queue_pending() > 0 && out_queue_flush() != 0) {
+            return -1;
         }
-        if (1){
-            check_state_ipc();
+        evlog_idle();
+        int slice_ms = out_queue_pending() > 0 ? 1 : LIVENESS_SLICE_MS;
+        if (deadline_ns != 0) {
+            uint64_t now_ns = liveness_now_ns();
+            if (now_ns >= deadline_ns) {
+                return IPC_TIMEOUT;
+            }
+            if ((deadline_ns - now_ns) / 1000000 < (uint64_t) slice_ms) {
+                slice_ms = (deadline_ns - now_ns) / 1000000 + 1;
+            }
         }
-        if (availability_status == 0) {
+        int ready = poll(fds, count, slice_ms);
+        ipc_stats.syscalls++;
+        if (ready > 0) {
             return 0;
         }
+        if (ready < 0 && errno != EINTR) {
+            perror("Failed to wait for a message");
+            return -1;
+        }
+        if (ready == 0) {
+            live_stats_publish(proc_info, get_lamport_time());
+            if (liveness_check(proc_info->pid) != 0) {
+                return -1;
+            }
+        }
     }
-    if (1) check_state_ipc();
+}
+
+int wait_for_message_availability(Process *proc_info, local_id sender_id, Message *msg_buffer, uint64_t deadline_ns) {
+    int read_descriptor = get_read_descriptor(proc_info, sender_id);
+    while (!proc_info->channels[sender_id].c_closed) {
+        int availability_status = check_availability(read_descriptor, msg_buffer);
+        if (availability_status == CHECK_READY) {
+            return 0;
+        }
+        if (availability_status == CHECK_CLOSED) {
+            proc_info->channels[sender_id].c_closed = 1;
+            break;
+        }
+        if (availability_status != CHECK_EMPTY) {
+            return -1;
+        }
+        struct pollfd readable = {.fd = read_descriptor, .events = POLLIN};
+        int wait_status = wait_readable(proc_info, &readable, 1, deadline_ns);
+        if (wait_status == IPC_TIMEOUT) {
+            fprintf(stderr, "Error: process %d timed out waiting for process %d\n", proc_info->pid, sender_id);
+        }
+        if (wait_status != 0) {
+            return wait_status;
+        }
+    }
+    fprintf(stderr, "Error: process %d closed its channel while process %d waits for a message\n",
+            sender_id, proc_info->pid);
     return -1;
 }
 
@@ -313,21 +454,55 @@ int receive_message2(int read_descriptor, Message *msg_buffer) {
     return read_message_body(read_descriptor, msg_buffer);
 }
 
+int receive_one(Process *proc_info, local_id sender_id, Message *msg_buffer, uint64_t deadline_ns) {
+    int read_descriptor = get_read_descriptor_for_process(proc_info, sender_id);
+    if (1){
+        check_state_ipc();
+    }
+    int wait_status = wait_for_message_availability(proc_info, sender_id, msg_buffer, deadline_ns);
+    if (wait_status != 0) {
+        return wait_status;
+    }
+    TRACE_RECEIVE_HEADER(msg_buffer->s_header.s_local_time, sender_id, proc_info->pid, msg_buffer->s_header.s_type);
+    if (1) check_state_ipc();
+    int receive_status = receive_message2(read_descriptor, msg_buffer);
+    if (receive_status == 0) {
+        ipc_stats_on_receive(sender_id, &msg_buffer->s_header);
+        if (msg_slots_on_receive(msg_buffer) != 0) {
+            return -1;
+        }
+        flow_on_receive(msg_buffer);
+        trace_on_receive(sender_id, proc_info->pid, msg_buffer);
+        if (mtree_on_receive(proc_info, msg_buffer) != 0) {
+            return -1;
+        }
+        TRACE_RECEIVE_PAYLOAD(msg_buffer->s_header.s_local_time, sender_id, proc_info->pid,
+                              msg_buffer->s_header.s_type, msg_buffer->s_header.s_payload_len);
+    }
+    return receive_status;
+}
+
 int receive(void *process_context, local_id sender_id, Message *msg_buffer) {
+    return receive_until(process_context, sender_id, msg_buffer, liveness_deadline());
+}
+
+int receive_until(void *process_context, local_id sender_id, Message *msg_buffer, uint64_t deadline_ns) {
     if (validate_receive_arguments(process_context, msg_buffer) < 0) {
         return -1;
     }
 
     Process *proc_info = (Process *)process_context;
-    int read_descriptor = get_read_descriptor_for_process(proc_info, sender_id);
-    if (1){
-        check_state_ipc();
-    }
-    if (wait_for_message_availability(read_descriptor, msg_buffer) < 0) {
-        return -1;
+    while (1) {
+        int receive_status = receive_one(proc_info, sender_id, msg_buffer, deadline_ns);
+        if (receive_status != 0) {
+            return receive_status;
+        }
+        // snapshot markers and reports never reach the caller, wait for the next message
+        int snapshot_status = snapshot_on_receive(proc_info, sender_id, msg_buffer);
+        if (snapshot_status <= 0) {
+            return snapshot_status;
+        }
     }
-    if (1) check_state_ipc();
-    return receive_message2(read_descriptor, msg_buffer);
 }
 
 
@@ -348,23 +523,28 @@ int read_payload1(int channel_fd, Message *msg_buffer) {
     return message(channel_fd, msg_buffer);
 }
 
+/// 0 for a header, 1 for an empty channel, 2 for a closed one, -1 on error.
 int handle_check_result(int availability_check) {
-    if (availability_check == 2) {
+    if (availability_check == CHECK_EMPTY) {
         return 1;
     }
-    if (availability_check < 0) {
+    if (availability_check == CHECK_CLOSED) {
+        return 2;
+    }
+    if (availability_check != CHECK_READY) {
         return -1;
     }
     return 0;
 }
 
-int read_message_from_channel(int channel_fd, Message *msg_buffer) {
+int read_message_from_channel(int channel_fd, local_id src_id, local_id dst_id, Message *msg_buffer) {
     int availability_check = check_availability1(channel_fd, msg_buffer);
     int availability_result = handle_check_result(availability_check);
 
     if (availability_result != 0) {
         return availability_result;
     }
+    TRACE_RECEIVE_HEADER(msg_buffer->s_header.s_local_time, src_id, dst_id, msg_buffer->s_header.s_type);
     if (1){
         check_state_ipc();
     }
@@ -373,6 +553,8 @@ int read_message_from_channel(int channel_fd, Message *msg_buffer) {
         if (1) check_state_ipc();
         return -2;
     }
+    TRACE_RECEIVE_PAYLOAD(msg_buffer->s_header.s_local_time, src_id, dst_id,
+                          msg_buffer->s_header.s_type, msg_buffer->s_header.s_payload_len);
 
     return 0;
 }
@@ -386,32 +568,95 @@ int validate_input_and_return(void *context, Message *msg_buffer) {
     return 0;
 }
 
-int read_message_from_channel_and_handle(int channel_fd, Message *msg_buffer) {
-    int result = read_message_from_channel(channel_fd, msg_buffer);
+int read_message_from_channel_and_handle(int channel_fd, local_id src_id, local_id dst_id, Message *msg_buffer) {
+    return read_message_from_channel(channel_fd, src_id, dst_id, msg_buffer);
+}
+
+int process_message(int src_id, Process *active_proc, Message *msg_buffer) {
+    int channel_fd = active_proc->channels[src_id].c_read_fd;
+    int result = read_message_from_channel_and_handle(channel_fd, src_id, active_proc->pid, msg_buffer);
+    if (result == 2) {
+        // the peer has exited, receive_any() stops asking it
+        active_proc->channels[src_id].c_closed = 1;
+        return 1;
+    }
     if (result == 1) {
         return 1;
     }
     if (result < 0) {
+        fprintf(stderr, "Процесс %d: ошибка при чтении от процесса %d\n", active_proc->pid, src_id);
         return result;
     }
+    ipc_stats_on_receive(src_id, &msg_buffer->s_header);
+    if (msg_slots_on_receive(msg_buffer) != 0) {
+        return -1;
+    }
+    flow_on_receive(msg_buffer);
+    trace_on_receive(src_id, active_proc->pid, msg_buffer);
+    if (mtree_on_receive(active_proc, msg_buffer) != 0) {
+        return -1;
+    }
+    int snapshot_status = snapshot_on_receive(active_proc, src_id, msg_buffer);
+    if (snapshot_status != 0) {
+        // a consumed marker or report reads as an empty channel
+        return snapshot_status < 0 ? -1 : 1;
+    }
+    LOG_DEBUG("Процесс %d: сообщение от процесса %d успешно получено и обработано\n", active_proc->pid, src_id);
     return 0;
 }
 
-int process_message(int src_id, Process active_proc, Message *msg_buffer) {
-    int channel_fd = active_proc.pipes[src_id][active_proc.pid].fd[READ];
-    int result = read_message_from_channel_and_handle(channel_fd, msg_buffer);
-    if (result == 1) {
-        return 1;
+int scan_channels_once(Process *active_proc, Message *msg_buffer) {
+    int open_channels = 0;
+    for (local_id src_id = 0; src_id < active_proc->num_process; ++src_id) {
+        if (src_id == active_proc->pid || active_proc->channels[src_id].c_closed) {
+            continue;
+        }
+        open_channels++;
+        if (1){
+            check_state_ipc();
+        }
+        int result = process_message(src_id, active_proc, msg_buffer);
+        if (result <= 0) {
+            return result;
+        }
     }
-    if (result < 0) {
-        fprintf(stderr, "Процесс %d: ошибка при чтении от процесса %d\n", active_proc.pid, src_id);
-        return result;
+    if (open_channels == 0) {
+        fprintf(stderr, "Error: every peer of process %d has closed its channel\n", active_proc->pid);
+        return -1;
     }
-    printf("Процесс %d: сообщение от процесса %d успешно получено и обработано\n", active_proc.pid, src_id);
-    return 0;
+    return 1;
+}
+
+int wait_any_readable(void *context, uint64_t deadline_ns) {
+    Process *proc_info = (Process *)context;
+    struct pollfd readable[MAX_PROCESS_ID + 1];
+    nfds_t count = 0;
+    for (local_id src_id = 0; src_id < proc_info->num_process; ++src_id) {
+        if (src_id != proc_info->pid && !proc_info->channels[src_id].c_closed) {
+            readable[count].fd = proc_info->channels[src_id].c_read_fd;
+            readable[count++].events = POLLIN;
+        }
+    }
+    if (count == 0) {
+        fprintf(stderr, "Error: every peer of process %d has closed its channel\n", proc_info->pid);
+        return -1;
+    }
+    return wait_readable(proc_info, readable, count, deadline_ns);
+}
+
+int try_receive_any(void *context, Message *msg_buffer) {
+    int validation_result = validate_input_and_return(context, msg_buffer);
+    if (validation_result != 0) {
+        return validation_result;
+    }
+    return scan_channels_once((Process *)context, msg_buffer);
 }
 
 int receive_any(void *context, Message *msg_buffer) {
+    return receive_any_until(context, msg_buffer, liveness_deadline());
+}
+
+int receive_any_until(void *context, Message *msg_buffer, uint64_t deadline_ns) {
     int validation_result = validate_input_and_return(context, msg_buffer);
     if (validation_result != 0) {
         return validation_result;
@@ -421,27 +666,22 @@ int receive_any(void *context, Message *msg_buffer) {
     if (1){
         check_state_ipc();
     }
-    Process active_proc = *proc_info;
-
     while (1) {
         if (1) check_state_ipc();
-        for (local_id src_id = 0; src_id < active_proc.num_process; ++src_id) {
-            if (src_id == active_proc.pid) {
-                continue;
-            }
-            if (1){
-                check_state_ipc();
-            }
-            int result = process_message(src_id, active_proc, msg_buffer);
-            if (result == 0) {
-                return 0;
-            }
-            if (result < 0) {
-                return result;
-            }
+        int result = scan_channels_once(proc_info, msg_buffer);
+        if (result <= 0) {
+            return result;
+        }
+        live_stats_tick(proc_info, get_lamport_time());
+        int wait_status = wait_any_readable(proc_info, deadline_ns);
+        if (wait_status == IPC_TIMEOUT) {
+            fprintf(stderr, "Error: process %d timed out waiting for a message from any process\n", proc_info->pid);
+        }
+        if (wait_status != 0) {
+            return wait_status;
         }
     }
 
-    fprintf(stderr, "Процесс %d: не удалось получить сообщение ни от одного процесса\n", active_proc.pid);
+    fprintf(stderr, "Процесс %d: не удалось получить сообщение ни от одного процесса\n", proc_info->pid);
     return -4;
 }
@@ -0,0 +1,127 @@
+#define _DEFAULT_SOURCE
+
+#include "ipc_stats.h"
+#include <string.h>
+#include <sys/mman.h>
+
+
+IpcStats ipc_stats;
+
+static const char* const type_names[IPC_STATS_TYPES] = {
+    "STARTED", "DONE", "ACK", "STOP", "TRANSFER", "HISTORY", "CS_REQ", "CS_REP", "CS_REL", "CS_TOK",
+    "MARKER", "REPORT", "OTHER"
+};
+
+IpcStatsTable* ipc_stats_table_create(void) {
+    IpcStatsTable* table = mmap(NULL, sizeof(IpcStatsTable), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) {
+        perror("Failed to map IPC stats table");
+        return NULL;
+    }
+    return table;
+}
+
+void ipc_stats_table_destroy(IpcStatsTable* table) {
+    if (table != NULL) {
+        munmap(table, sizeof(IpcStatsTable));
+    }
+}
+
+void ipc_stats_reset(void) {
+    memset(&ipc_stats, 0, sizeof(ipc_stats));
+}
+
+void ipc_stats_publish(IpcStatsTable* table, local_id id) {
+    if (table == NULL) {
+        return;
+    }
+    memcpy(&table->processes[id], &ipc_stats, sizeof(IpcStats));
+    __atomic_store_n(&table->processes[id].published, 1, __ATOMIC_RELEASE);
+}
+
+static uint64_t channel_total(const ChannelCounters* counters, int bytes) {
+    uint64_t total = 0;
+    for (int bucket = 0; bucket < IPC_STATS_TYPES; bucket++) {
+        total += bytes ? counters->c_bytes[bucket] : counters->c_msgs[bucket];
+    }
+    return total;
+}
+
+static void report_channels(const IpcStatsTable* table, int num_process, FILE* output) {
+    fprintf(output, "%-9s %8s %10s %8s", "channel", "sent", "bytes", "received");
+    for (int bucket = 0; bucket < IPC_STATS_TYPES; bucket++) {
+        fprintf(output, " %8s", type_names[bucket]);
+    }
+    fprintf(output, "\n");
+
+    for (int src = 0; src < num_process; src++) {
+        for (int dst = 0; dst < num_process; dst++) {
+            const ChannelCounters* sent = &table->processes[src].sent[dst];
+            const ChannelCounters* received = &table->processes[dst].received[src];
+            uint64_t sent_msgs = channel_total(sent, 0);
+            if (src == dst || (sent_msgs == 0 && channel_total(received, 0) == 0)) {
+                continue;
+            }
+            fprintf(output, "%2d -> %-3d %8llu %10llu %8llu", src, dst, (unsigned long long) sent_msgs,
+                    (unsigned long long) channel_total(sent, 1),
+                    (unsigned long long) channel_total(received, 0));
+            for (int bucket = 0; bucket < IPC_STATS_TYPES; bucket++) {
+                fprintf(output, " %8llu", (unsigned long long) sent->c_msgs[bucket]);
+            }
+            fprintf(output, "\n");
+        }
+    }
+}
+
+static void report_processes(const IpcStatsTable* table, int num_process, FILE* output) {
+    IpcStats total;
+    memset(&total, 0, sizeof(total));
+
+    fprintf(output, "%-9s %12s %12s %12s %12s\n", "process", "eagain", "short_rd", "short_wr", "syscalls");
+    for (int id = 0; id < num_process; id++) {
+        const IpcStats* stats = &table->processes[id];
+        if (!__atomic_load_n(&stats->published, __ATOMIC_ACQUIRE)) {
+            fprintf(output, "%-9d %12s\n", id, "n/a");
+            continue;
+        }
+        fprintf(output, "%-9d %12llu %12llu %12llu %12llu\n", id,
+                (unsigned long long) stats->eagain_spins, (unsigned long long) stats->short_reads,
+                (unsigned long long) stats->short_writes, (unsigned long long) stats->syscalls);
+        total.eagain_spins += stats->eagain_spins;
+        total.short_reads += stats->short_reads;
+        total.short_writes += stats->short_writes;
+        total.syscalls += stats->syscalls;
+    }
+    fprintf(output, "%-9s %12llu %12llu %12llu %12llu\n", "total",
+            (unsigned long long) total.eagain_spins, (unsigned long long) total.short_reads,
+            (unsigned long long) total.short_writes, (unsigned long long) total.syscalls);
+}
+
+void ipc_stats_totals(const IpcStatsTable* table, int num_process, uint64_t* msgs_by_type, uint64_t* bytes) {
+    memset(msgs_by_type, 0, IPC_STATS_TYPES * sizeof(uint64_t));
+    *bytes = 0;
+    if (table == NULL) {
+        return;
+    }
+    for (int id = 0; id < num_process; id++) {
+        for (int peer = 0; peer < num_process; peer++) {
+            const ChannelCounters* sent = &table->processes[id].sent[peer];
+            for (int bucket = 0; bucket < IPC_STATS_TYPES; bucket++) {
+                msgs_by_type[bucket] += sent->c_msgs[bucket];
+                *bytes += sent->c_bytes[bucket];
+            }
+        }
+    }
+}
+
+void ipc_stats_report(const IpcStatsTable* table, int num_process, FILE* output) {
+    if (table == NULL) {
+        return;
+    }
+    fprintf(output, "=== IPC stats: channels ===\n");
+    report_channels(table, num_process, output);
+    fprintf(output, "=== IPC stats: processes ===\n");
+    report_processes(table, num_process, output);
+    fflush(output);
+}
@@ -0,0 +1,70 @@
+#ifndef IPC_STATS_H
+#define IPC_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ipc.h"
+#include "message_flags.h"
+
+enum {
+    IPC_STATS_OTHER_TYPE = SNAPSHOT_REPORT + 1,  ///< bucket for unknown message types
+    IPC_STATS_TYPES,
+    IPC_STATS_CHANNELS = MAX_PROCESS_ID + 1
+};
+
+typedef struct {
+    uint64_t c_msgs[IPC_STATS_TYPES];
+    uint64_t c_bytes[IPC_STATS_TYPES];
+} ChannelCounters;
+
+/**
+ * Counters of one process. sent[dst] and received[src] are indexed by the
+ * peer id, so the parent can rebuild every src->dst channel of the mesh.
+ */
+typedef struct {
+    ChannelCounters sent[IPC_STATS_CHANNELS];
+    ChannelCounters received[IPC_STATS_CHANNELS];
+    uint64_t        eagain_spins;
+    uint64_t        short_reads;
+    uint64_t        short_writes;
+    uint64_t        syscalls;
+    uint8_t         published;
+} IpcStats;
+
+typedef struct {
+    IpcStats processes[IPC_STATS_CHANNELS];
+} IpcStatsTable;
+
+extern IpcStats ipc_stats;
+
+static inline int ipc_stats_bucket(int16_t s_type) {
+    int16_t type = message_base_type(s_type);
+    return (type >= STARTED && type < IPC_STATS_OTHER_TYPE) ? type : IPC_STATS_OTHER_TYPE;
+}
+
+static inline void ipc_stats_on_send(local_id dst, const MessageHeader* header) {
+    int bucket = ipc_stats_bucket(header->s_type);
+    ipc_stats.sent[dst].c_msgs[bucket]++;
+    ipc_stats.sent[dst].c_bytes[bucket] += sizeof(MessageHeader) + header->s_payload_len;
+}
+
+static inline void ipc_stats_on_receive(local_id src, const MessageHeader* header) {
+    int bucket = ipc_stats_bucket(header->s_type);
+    ipc_stats.received[src].c_msgs[bucket]++;
+    ipc_stats.received[src].c_bytes[bucket] += sizeof(MessageHeader) + header->s_payload_len;
+}
+
+IpcStatsTable* ipc_stats_table_create(void);
+
+void ipc_stats_table_destroy(IpcStatsTable* table);
+
+void ipc_stats_reset(void);
+
+void ipc_stats_publish(IpcStatsTable* table, local_id id);
+
+void ipc_stats_totals(const IpcStatsTable* table, int num_process, uint64_t* msgs_by_type, uint64_t* bytes);
+
+void ipc_stats_report(const IpcStatsTable* table, int num_process, FILE* output);
+
+#endif
@@ -0,0 +1,143 @@
+#define _DEFAULT_SOURCE
+
+#include "live_stats.h"
+#include "ipc_stats.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+
+static LiveStatsPage* live_page = NULL;
+static LiveSlot* live_slot = NULL;
+static uint32_t live_ticks = 0;
+static uint32_t live_pending = 0;
+
+LiveStatsPage* live_stats_create(const char* path, int num_process) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to create live stats page");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(LiveStatsPage)) != 0) {
+        perror("Failed to size live stats page");
+        close(fd);
+        return NULL;
+    }
+    LiveStatsPage* page = mmap(NULL, sizeof(LiveStatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        perror("Failed to map live stats page");
+        return NULL;
+    }
+    page->ls_parent_pid = getpid();
+    page->ls_num_process = num_process;
+    page->ls_finished = 0;
+    __atomic_store_n(&page->ls_magic, LIVE_STATS_MAGIC, __ATOMIC_RELEASE);
+    return page;
+}
+
+LiveStatsPage* live_stats_attach(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open live stats page");
+        return NULL;
+    }
+    LiveStatsPage* page = mmap(NULL, sizeof(LiveStatsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        perror("Failed to map live stats page");
+        return NULL;
+    }
+    if (__atomic_load_n(&page->ls_magic, __ATOMIC_ACQUIRE) != LIVE_STATS_MAGIC) {
+        fprintf(stderr, "Error: %s is not a live stats page\n", path);
+        munmap(page, sizeof(LiveStatsPage));
+        return NULL;
+    }
+    return page;
+}
+
+void live_stats_bind(LiveStatsPage* page, local_id id) {
+    live_page = page;
+    live_slot = page ? &page->ls_slots[id] : NULL;
+    live_ticks = 0;
+    live_pending = 0;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+static uint64_t channel_messages(const ChannelCounters* counters) {
+    uint64_t total = 0;
+    for (int bucket = 0; bucket < IPC_STATS_TYPES; bucket++) {
+        total += counters->c_msgs[bucket];
+    }
+    return total;
+}
+
+void live_stats_publish(const Process* process, timestamp_t lamport) {
+    if (live_slot == NULL) {
+        return;
+    }
+    uint32_t seq = live_slot->l_seq;
+    __atomic_store_n(&live_slot->l_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    live_slot->l_pid = getpid();
+    live_slot->l_lamport = lamport;
+    live_slot->l_balance = process->cur_balance;
+    live_slot->l_pending_transfers = live_pending;
+    live_slot->l_updated_ns = monotonic_ns();
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    for (int peer = 0; peer < process->num_process; peer++) {
+        live_slot->l_sent_to[peer] = channel_messages(&ipc_stats.sent[peer]);
+        live_slot->l_received_from[peer] = channel_messages(&ipc_stats.received[peer]);
+        sent += live_slot->l_sent_to[peer];
+        received += live_slot->l_received_from[peer];
+    }
+    live_slot->l_msgs_sent = sent;
+    live_slot->l_msgs_received = received;
+
+    __atomic_store_n(&live_slot->l_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void live_stats_tick(const Process* process, timestamp_t lamport) {
+    if (live_slot == NULL) {
+        return;
+    }
+    if (++live_ticks % LIVE_STATS_PUBLISH_EVERY == 0) {
+        live_stats_publish(process, lamport);
+    }
+}
+
+void live_stats_set_pending(uint32_t pending_transfers) {
+    live_pending = pending_transfers;
+}
+
+void live_stats_finish(LiveStatsPage* page) {
+    if (page != NULL) {
+        __atomic_store_n(&page->ls_finished, 1, __ATOMIC_RELEASE);
+    }
+}
+
+int live_stats_read(const LiveStatsPage* page, local_id id, LiveSlot* snapshot) {
+    const LiveSlot* slot = &page->ls_slots[id];
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint32_t before = __atomic_load_n(&slot->l_seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, (const void*) slot, sizeof(LiveSlot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->l_seq, __ATOMIC_RELAXED) == before) {
+            return 0;
+        }
+    }
+    return -1;
+}
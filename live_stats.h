@@ -0,0 +1,57 @@
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <stdint.h>
+
+#include "base_vars.h"
+
+/**
+ * One process' view published for tools/pa_top. Writers bump l_seq to an
+ * odd value, update the fields and bump it back to even; readers retry
+ * while l_seq is odd or changed under them (seqlock).
+ */
+typedef struct {
+    uint32_t    l_seq;
+    int32_t     l_pid;
+    timestamp_t l_lamport;
+    balance_t   l_balance;
+    uint32_t    l_pending_transfers;    ///< TRANSFERs waiting for ACK, parent only
+    uint64_t    l_updated_ns;           ///< CLOCK_MONOTONIC of the last update
+    uint64_t    l_msgs_sent;
+    uint64_t    l_msgs_received;
+    uint64_t    l_sent_to[MAX_PROCESS_ID + 1];
+    uint64_t    l_received_from[MAX_PROCESS_ID + 1];
+} LiveSlot;
+
+typedef struct {
+    uint32_t ls_magic;
+    int32_t  ls_parent_pid;
+    int32_t  ls_num_process;
+    uint32_t ls_finished;
+    LiveSlot ls_slots[MAX_PROCESS_ID + 1];
+} LiveStatsPage;
+
+enum {
+    LIVE_STATS_MAGIC = 0x50415450,
+    LIVE_STATS_PUBLISH_EVERY = 32   ///< ticks between two publications
+};
+
+static const char * const live_stats_default_path = "pa_live.stats";
+
+LiveStatsPage* live_stats_create(const char* path, int num_process);
+
+LiveStatsPage* live_stats_attach(const char* path);
+
+void live_stats_bind(LiveStatsPage* page, local_id id);
+
+void live_stats_tick(const Process* process, timestamp_t lamport);
+
+void live_stats_publish(const Process* process, timestamp_t lamport);
+
+void live_stats_set_pending(uint32_t pending_transfers);
+
+void live_stats_finish(LiveStatsPage* page);
+
+int live_stats_read(const LiveStatsPage* page, local_id id, LiveSlot* snapshot);
+
+#endif
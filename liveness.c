@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "liveness.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+static int timeout_ms = 0;
+static pid_t parent_pid = 0;
+static pid_t child_pids[MAX_PROCESS_ID + 1];
+
+void liveness_reset(void) {
+    parent_pid = 0;
+    memset(child_pids, 0, sizeof(child_pids));
+}
+
+void liveness_set_timeout(int timeout) {
+    timeout_ms = timeout;
+}
+
+uint64_t liveness_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+uint64_t liveness_deadline(void) {
+    return timeout_ms > 0 ? liveness_now_ns() + (uint64_t) timeout_ms * 1000000ull : 0;
+}
+
+void liveness_watch_child(local_id id, pid_t pid) {
+    child_pids[id] = pid;
+}
+
+void liveness_watch_parent(void) {
+    parent_pid = getppid();
+    memset(child_pids, 0, sizeof(child_pids));
+}
+
+static local_id child_id(pid_t pid) {
+    for (local_id id = 1; id <= MAX_PROCESS_ID; id++) {
+        if (child_pids[id] == pid) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+/// Children that exit cleanly are reaped here too, wait() at the end of the run skips them.
+static int check_children(local_id self) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            continue;
+        }
+        if (WIFSIGNALED(status)) {
+            fprintf(stderr, "Error: process %d (pid %d) was killed by signal %d, process %d gives up\n",
+                    child_id(pid), pid, WTERMSIG(status), self);
+        } else {
+            fprintf(stderr, "Error: process %d (pid %d) exited with status %d, process %d gives up\n",
+                    child_id(pid), pid, WEXITSTATUS(status), self);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int liveness_check(local_id self) {
+    if (self == PARENT_ID) {
+        return check_children(self);
+    }
+    if (parent_pid != 0 && getppid() != parent_pid) {
+        fprintf(stderr, "Error: parent process %d is gone, process %d gives up\n", parent_pid, self);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ipc.h"
+
+/**
+ * Failure detection for the blocking receives of ipc.c, run whenever a
+ * wait slice of LIVENESS_SLICE_MS passes without data. The parent reaps
+ * its children with waitpid(WNOHANG) and fails on any that died or exited
+ * with an error. A child fails once its parent is gone (it was
+ * re-parented). A closed channel is reported by ipc.c itself as EOF.
+ * Waits may also be bounded with --timeout, see liveness_deadline().
+ */
+enum {
+    LIVENESS_SLICE_MS = 100
+};
+
+void liveness_reset(void);
+
+/// Longest wait of a receive or a barrier, 0 for as long as the peers are alive.
+void liveness_set_timeout(int timeout_ms);
+
+uint64_t liveness_now_ns(void);
+
+/// CLOCK_MONOTONIC deadline of a wait starting now, 0 for none.
+uint64_t liveness_deadline(void);
+
+/// Parent side, right after fork().
+void liveness_watch_child(local_id id, pid_t pid);
+
+/// Child side, first thing after fork().
+void liveness_watch_parent(void);
+
+/// Returns -1 after printing which process is gone.
+int liveness_check(local_id self);
+
+#endif
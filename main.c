@@ -1,72 +1,32 @@
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <asm-generic/errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "banking.h"
+#include "pa2345.h"
+#include "runner.h"
 
-#include "helpers.h"
-#include "common.h"
-#include "pipes_helper.h"
-
-
-void send_transfer_message(void *context_data, local_id initiator, local_id recipient, balance_t transfer_amount) {
-    TransferOrder transfer_info;
-    transfer_info.s_src = initiator;
-    transfer_info.s_dst = recipient;
-    transfer_info.s_amount = transfer_amount;
-    lmprd_time_upgrade();
-    mess_to(context_data, TRANSFER, &transfer_info);
-}
 
 const int FLAG_MAIN = 1;
 
-int receive_acknowledgement(void *context_data, local_id recipient, Message *ack_message) {
-    int ack_status = receive(context_data, recipient, ack_message);
-    if (ack_status != 0) {
-        fprintf(stderr, "Ошибка: подтверждение от процесса %d не получено\n", recipient);
-        exit(EXIT_FAILURE);
-    }
-    return ack_status;
-}
-
 void check_state_main() {
     int x = FLAG_MAIN;
     (void)x;
 }
 
-void transfer(void *context_data, local_id initiator, local_id recipient, balance_t transfer_amount) {
-    send_transfer_message(context_data, initiator, recipient, transfer_amount);
-    Message ack_message;
-    receive_acknowledgement(context_data, recipient, &ack_message);
-    lmprd_time_update(ack_message.s_header.s_local_time);
-}
-
 void check_arguments(int argc, char *argv[], int *num_processes) {
     if (argc < 3 || strcmp("-p", argv[1]) != 0) {
         fprintf(stderr, "Usage: -p X\n");
         exit(1);
     }
     *num_processes = atoi(argv[2]);
-    if (*num_processes < 1 || *num_processes > 10) {
-        fprintf(stderr, "Process count should be between 1 and 10\n");
+    if (*num_processes < 1 || *num_processes > MAX_PROCESS_ID) {
+        fprintf(stderr, "Process count should be between 1 and %d\n", MAX_PROCESS_ID);
         exit(1);
     }
     (*num_processes)++;
 }
 
-void init_log_files(FILE **log_pipes, FILE **log_events) {
-    *log_pipes = fopen("pipes.log", "w+");
-    if (!*log_pipes) {
-        perror("Failed to open pipes.log");
-        exit(1);
-    }
-    *log_events = fopen("events.log", "w+");
-    if (!*log_events) {
-        perror("Failed to open events.log");
-        fclose(*log_pipes);
-        exit(1);
-    }
-}
-
 int validate_argument_count(int argc, int num_processes) {
     if (argc < num_processes + 2) {
         fprintf(stderr, "Provide initial balance values for each process\n");
@@ -104,142 +64,54 @@ void process_balances(int argc, char *argv[], int *balances, int num_processes)
     process_balances_for_each_process(balances, argv, num_processes);
 }
 
-void initialize_child_process(Process *child_proc, int i, int num_processes, Pipe **pipes, int *balances) {
-    child_proc->num_process = num_processes;
-    child_proc->pipes = pipes;
-    child_proc->pid = i;
-    child_proc->cur_balance = balances[i - 1];
-    child_proc->history.s_id = i;
-    child_proc->history.s_history_len = 0;
-}
-
-void log_child_start(FILE *log_events, Process *child_proc, int i) {
-    update_chronicle(&(child_proc->history), get_lamport_time(), child_proc->cur_balance, 0);
-    mess_to(child_proc, STARTED, NULL);
-    fprintf(log_events, log_started_fmt, get_lamport_time(), i, getpid(), getppid(), child_proc->cur_balance);
-}
-
-void check_child_start(Process *child_proc, FILE *log_events, int i) {
-    if (is_every_get(child_proc, STARTED) != 0) {
-        fprintf(stderr, "Error: Process %d failed to receive all STARTED messages\n", i);
-        exit(EXIT_FAILURE);
-    }
-    fprintf(log_events, log_received_all_started_fmt, get_lamport_time(), i);
-}
-
-void perform_bank_operations(Process *child_proc, FILE *log_events) {
-    ops_commands(child_proc, log_events);
-}
-
-void close_child_pipes(Process *child_proc, FILE *log_pipes) {
-    drop_pipes_that_out(child_proc, log_pipes);
-    drop_pipes_that_in(child_proc, log_pipes);
-}
-
-void handle_child_process(int i, int num_processes, Pipe **pipes, int *balances, FILE *log_pipes, FILE *log_events) {
-    Process child_proc;
-    initialize_child_process(&child_proc, i, num_processes, pipes, balances);
-
-    drop_pipes_that_non_rel(&child_proc, log_pipes);
-    log_child_start(log_events, &child_proc, i);
-    check_child_start(&child_proc, log_events, i);
-
-    perform_bank_operations(&child_proc, log_events);
-    close_child_pipes(&child_proc, log_pipes);
-
-    exit(EXIT_SUCCESS);
-}
-
-void create_child_processes(int num_processes, Pipe **pipes, int *balances, FILE *log_pipes, FILE *log_events) {
-    for (local_id i = 1; i < num_processes; ++i) {
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("Fork failed");
-            exit(EXIT_FAILURE);
-        }
-        if (pid == 0) {
-            handle_child_process(i, num_processes, pipes, balances, log_pipes, log_events);
-        }
-    }
-}
-
-void wait_for_children() {
-    while (wait(NULL) > 0);
-}
-
-void cleanup(FILE *log_pipes, FILE *log_events) {
-    fclose(log_pipes);
-    fclose(log_events);
-}
-
 void handle_arguments(int argc, char *argv[], int *num_processes) {
     check_arguments(argc, argv, num_processes);
 }
 
-void initialize_log_files(FILE **log_pipes, FILE **log_events) {
-    init_log_files(log_pipes, log_events);
-}
-
 void handle_balances(int argc, char *argv[], int *balances, int num_processes) {
     process_balances(argc, argv, balances, num_processes);
 }
 
-Pipe** initialize_pipes(int num_processes, FILE *log_pipes) {
-    return create_pipes(num_processes, log_pipes);
-}
-
-void create_child_processes_and_handle_pipes(int num_processes, Pipe **pipes, int *balances, FILE *log_pipes, FILE *log_events) {
-    create_child_processes(num_processes, pipes, balances, log_pipes, log_events);
-}
-
-int verify_received_messages(Process *parent_proc, FILE *log_pipes, MessageType expected_type, FILE *log_events) {
-    if (is_every_get(parent_proc, expected_type) != 0) {
-        fprintf(stderr, "Error: Parent process failed to receive all %s messages\n", (expected_type == STARTED) ? "STARTED" : "DONE");
-        cleanup(log_pipes, log_events);
-        exit(EXIT_FAILURE);
-    }
-    return 0;
-}
-
-void handle_parent_process_logic(Process *parent_proc, FILE *log_events, FILE *log_pipes) {
-    fprintf(log_events, log_received_all_started_fmt, get_lamport_time(), PARENT_ID);
+void run_bank_robbery(Process *parent_proc, void *workload_arg) {
+    (void) workload_arg;
     bank_robbery(parent_proc, parent_proc->num_process - 1);
-    mess_to(parent_proc, STOP, NULL);
-
-    verify_received_messages(parent_proc, log_pipes, DONE, log_events);
-    fprintf(log_events, log_received_all_done_fmt, get_lamport_time(), PARENT_ID);
-
-    chronicle(parent_proc);
 }
 
-void close_pipes_and_cleanup(Process *parent_proc, FILE *log_pipes, FILE *log_events) {
-    drop_pipes_that_out(parent_proc, log_pipes);
-    drop_pipes_that_in(parent_proc, log_pipes);
-    wait_for_children();
-    cleanup(log_pipes, log_events);
+void run_mutexl_loop(Process *child_proc, void *workload_arg) {
+    (void) workload_arg;
+    int iterations = child_proc->pid * 5;
+    char line[64];
+    for (int i = 1; i <= iterations; i++) {
+        if (request_cs(child_proc) != 0) {
+            exit(1);
+        }
+        snprintf(line, sizeof(line), log_loop_operation_fmt, child_proc->pid, i, iterations);
+        print(line);
+        if (release_cs(child_proc) != 0) {
+            exit(1);
+        }
+    }
 }
 
 int main(int argc, char *argv[]) {
+    RunConfig config;
+    memset(&config, 0, sizeof(config));
+    parse_run_options(&argc, argv, &config.options);
+
     int num_processes;
     handle_arguments(argc, argv, &num_processes);
 
-    FILE *log_pipes, *log_events;
-    initialize_log_files(&log_pipes, &log_events);
-
     int balances[num_processes - 1];
     handle_balances(argc, argv, balances, num_processes);
 
-    Pipe **pipes = initialize_pipes(num_processes, log_pipes);
-
-    create_child_processes_and_handle_pipes(num_processes, pipes, balances, log_pipes, log_events);
-
-    Process parent_proc = {.num_process = num_processes, .pipes = pipes, .pid = PARENT_ID};
-    drop_pipes_that_non_rel(&parent_proc, log_pipes);
-
-    verify_received_messages(&parent_proc, log_pipes, STARTED, log_events);
-
-    handle_parent_process_logic(&parent_proc, log_events, log_pipes);
-    close_pipes_and_cleanup(&parent_proc, log_pipes, log_events);
+    config.num_processes = num_processes;
+    config.balances = balances;
+    config.workload = run_bank_robbery;
+    if (config.options.mutexl) {
+        config.child_workload = run_mutexl_loop;
+    }
+    config.print_history = 1;
+    run_processes(&config);
 
     return 0;
 }
@@ -0,0 +1,46 @@
+#ifndef MESSAGE_FLAGS_H
+#define MESSAGE_FLAGS_H
+
+#include <stdint.h>
+
+#include "ipc.h"
+
+/*
+ * s_type of a Message carries the MessageType in its low byte. The high
+ * byte holds transport flags that receivers strip before the message
+ * reaches the banking code:
+ *   bits 8..12  root + 1 of a spanning-tree multicast (multicast_tree.c)
+ *   bit 13      the payload is a slot index of msg_slots.c
+ *   bit 14      an ACK's last payload byte returns a TRANSFER credit (flow_control.c)
+ */
+enum {
+    MESSAGE_TYPE_MASK = 0x00FF,
+    MESSAGE_ROOT_SHIFT = 8,
+    MESSAGE_ROOT_MASK = 0x1F << MESSAGE_ROOT_SHIFT,
+    MESSAGE_SLOT_FLAG = 1 << 13,
+    MESSAGE_CREDIT_FLAG = 1 << 14
+};
+
+/*
+ * Message types past MessageType of ipc.h, which must not be modified.
+ */
+enum {
+    CS_TOKEN = CS_RELEASE + 1,  ///< the Suzuki-Kasami token of mutex_sk.c
+    SNAPSHOT_MARKER,            ///< Chandy-Lamport marker of snapshot.c
+    SNAPSHOT_REPORT             ///< what a child recorded, sent to the parent
+};
+
+static inline int16_t message_base_type(int16_t s_type) {
+    return s_type & MESSAGE_TYPE_MASK;
+}
+
+/// Root of the tree multicast the message travels along, or -1.
+static inline int message_root(int16_t s_type) {
+    return ((s_type & MESSAGE_ROOT_MASK) >> MESSAGE_ROOT_SHIFT) - 1;
+}
+
+static inline int16_t message_with_root(int16_t s_type, local_id root) {
+    return (s_type & ~MESSAGE_ROOT_MASK) | ((root + 1) << MESSAGE_ROOT_SHIFT);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "message_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static Message* pool[MESSAGE_POOL_MAX];
+static int pool_count = 0;
+
+Message* message_pool_get(void) {
+    if (pool_count > 0) {
+        return pool[--pool_count];
+    }
+    Message* message = malloc(sizeof(Message));
+    if (message == NULL) {
+        perror("Failed to allocate a message");
+    }
+    return message;
+}
+
+void message_pool_put(Message* message) {
+    if (pool_count < MESSAGE_POOL_MAX) {
+        pool[pool_count++] = message;
+        return;
+    }
+    free(message);
+}
+
+MessageFrame* message_acquire(SmallMessage* small, size_t payload_len) {
+    if (payload_len <= SMALL_PAYLOAD_MAX) {
+        return &small->s_frame;
+    }
+    return (MessageFrame*) message_pool_get();
+}
+
+void message_release(SmallMessage* small, MessageFrame* frame) {
+    if (frame != NULL && frame != &small->s_frame) {
+        message_pool_put((Message*) frame);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include "ipc.h"
+
+/**
+ * ACK, STOP and TRANSFER frames carry a few bytes of payload, so building
+ * them in a 4 KB Message only spreads the hot loop over more stack. Every
+ * outgoing frame is a MessageFrame, a header followed by as much payload
+ * as its buffer holds: a SmallMessage on the stack for the short ones, a
+ * Message borrowed from a per-process pool for the rest (STARTED, DONE,
+ * BALANCE_HISTORY, long transfer tails). send_frame() and
+ * send_multicast_frame() only read the header and s_payload_len bytes.
+ */
+enum {
+    SMALL_PAYLOAD_MAX = 32,
+    MESSAGE_POOL_MAX = 8
+};
+
+typedef struct {
+    MessageHeader s_header;
+    char          s_payload[];
+} __attribute__((packed)) MessageFrame;
+
+typedef union {
+    MessageFrame s_frame;
+    char         s_bytes[sizeof(MessageHeader) + SMALL_PAYLOAD_MAX];
+} SmallMessage;
+
+/// A Message starts with a frame, so it can go wherever one is taken.
+static inline const MessageFrame* message_frame(const Message* message) {
+    return (const MessageFrame*) message;
+}
+
+static inline size_t message_frame_len(const Message* message) {
+    return sizeof(MessageHeader) + message->s_header.s_payload_len;
+}
+
+/// Copies the header and the payload, not the unused tail of the buffer.
+static inline void message_copy(Message* dst, const Message* src) {
+    memcpy(dst, src, message_frame_len(src));
+}
+
+Message* message_pool_get(void);
+
+void message_pool_put(Message* message);
+
+/// The frame of small when payload_len fits in it, of a pooled Message otherwise (NULL if out of memory).
+MessageFrame* message_acquire(SmallMessage* small, size_t payload_len);
+
+void message_release(SmallMessage* small, MessageFrame* frame);
+
+#endif
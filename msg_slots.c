@@ -0,0 +1,91 @@
+#define _DEFAULT_SOURCE
+
+#include "msg_slots.h"
+#include "message_flags.h"
+#include "message_pool.h"
+#include "helpers.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+MessageSlotArena* msg_slots = NULL;
+
+static uint32_t next_slot = 0;
+
+MessageSlotArena* msg_slots_create(void) {
+    MessageSlotArena* arena = mmap(NULL, sizeof(MessageSlotArena), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+        perror("Failed to map message slots");
+        return NULL;
+    }
+    return arena;
+}
+
+void msg_slots_destroy(MessageSlotArena* arena) {
+    if (arena != NULL) {
+        munmap(arena, sizeof(MessageSlotArena));
+    }
+}
+
+void msg_slots_bind(MessageSlotArena* arena) {
+    msg_slots = arena;
+    next_slot = 0;
+}
+
+static int claim_slot(uint32_t refs) {
+    for (int tried = 0; tried < MSG_SLOTS_COUNT; tried++) {
+        uint32_t index = next_slot++ % MSG_SLOTS_COUNT;
+        uint32_t free_refs = 0;
+        if (__atomic_compare_exchange_n(&msg_slots->slots[index].s_refs, &free_refs, refs, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int msg_slots_multicast(Process* proc, const MessageFrame* frame) {
+    int index = claim_slot(proc->num_process - 1);
+    if (index < 0) {
+        return 1;
+    }
+    Message* shared = &msg_slots->slots[index].s_message;
+    memcpy(shared, frame, sizeof(MessageHeader) + frame->s_header.s_payload_len);
+
+    // peers only see the slot after the write() of the descriptor, which orders the copy
+    SmallMessage descriptor;
+    descriptor.s_frame.s_header = frame->s_header;
+    descriptor.s_frame.s_header.s_type |= MESSAGE_SLOT_FLAG;
+    descriptor.s_frame.s_header.s_payload_len = sizeof(uint32_t);
+    uint32_t slot_ref = index;
+    memcpy(descriptor.s_frame.s_payload, &slot_ref, sizeof(slot_ref));
+
+    for (int idx = 0; idx < proc->num_process; idx++) {
+        if (idx != proc->pid && send_frame(proc, idx, &descriptor.s_frame) != 0) {
+            fprintf(stderr, "Process %d: slot multicast to %d failed\n", proc->pid, idx);
+            // the peers from idx on never see the slot, drop their references so it is freed
+            int unsent = proc->num_process - idx - (proc->pid >= idx ? 1 : 0);
+            __atomic_sub_fetch(&msg_slots->slots[index].s_refs, unsent, __ATOMIC_RELEASE);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int msg_slots_on_receive(Message* message) {
+    if (!(message->s_header.s_type & MESSAGE_SLOT_FLAG)) {
+        return 0;
+    }
+    uint32_t slot_ref;
+    memcpy(&slot_ref, message->s_payload, sizeof(slot_ref));
+    if (msg_slots == NULL || message->s_header.s_payload_len != sizeof(slot_ref) || slot_ref >= MSG_SLOTS_COUNT) {
+        fprintf(stderr, "Error: invalid message slot descriptor\n");
+        return -1;
+    }
+    MessageSlot* slot = &msg_slots->slots[slot_ref];
+    memcpy(message, &slot->s_message, sizeof(MessageHeader) + slot->s_message.s_header.s_payload_len);
+    __atomic_sub_fetch(&slot->s_refs, 1, __ATOMIC_RELEASE);
+    return 0;
+}
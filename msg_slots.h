@@ -0,0 +1,45 @@
+#ifndef MSG_SLOTS_H
+#define MSG_SLOTS_H
+
+#include <stdint.h>
+
+#include "base_vars.h"
+#include "message_pool.h"
+
+/**
+ * Zero-copy multicast, enabled with --zero-copy. The sender copies the
+ * message once into a free slot of a region mapped before fork(), sets its
+ * reference count to the number of peers and writes each of them a
+ * descriptor: the original header with MESSAGE_SLOT_FLAG set and the slot
+ * index as payload. Receivers resolve the descriptor from the slot and
+ * drop their reference; the last one frees the slot.
+ */
+typedef struct {
+    uint32_t s_refs;        ///< 0 when free
+    Message  s_message;
+} MessageSlot;
+
+enum {
+    MSG_SLOTS_COUNT = 64
+};
+
+typedef struct {
+    MessageSlot slots[MSG_SLOTS_COUNT];
+} MessageSlotArena;
+
+/// Arena of the current run, NULL when multicast copies the message per peer.
+extern MessageSlotArena* msg_slots;
+
+MessageSlotArena* msg_slots_create(void);
+
+void msg_slots_destroy(MessageSlotArena* arena);
+
+void msg_slots_bind(MessageSlotArena* arena);
+
+/// Returns 1 without sending anything when every slot is taken.
+int msg_slots_multicast(Process* proc, const MessageFrame* frame);
+
+/// Replaces a descriptor by the message it refers to.
+int msg_slots_on_receive(Message* message);
+
+#endif
@@ -0,0 +1,74 @@
+#include "multicast_tree.h"
+#include "message_flags.h"
+#include "helpers.h"
+#include <stdio.h>
+#include <string.h>
+
+
+int mtree_fanout = 0;
+
+void mtree_configure(int fanout) {
+    mtree_fanout = fanout;
+}
+
+static int tree_size(local_id root, int num_process) {
+    return root == PARENT_ID ? num_process : num_process - 1;
+}
+
+static local_id member_at(local_id root, int num_process, int position) {
+    if (root == PARENT_ID) {
+        return position;
+    }
+    return 1 + (root - 1 + position) % (num_process - 1);
+}
+
+static int position_of(local_id root, int num_process, local_id id) {
+    if (root == PARENT_ID) {
+        return id;
+    }
+    return (id - root + (num_process - 1)) % (num_process - 1);
+}
+
+static int send_to_subtree(Process* proc, local_id root, const MessageFrame* frame) {
+    int size = tree_size(root, proc->num_process);
+    int first = mtree_fanout * position_of(root, proc->num_process, proc->pid) + 1;
+    for (int position = first; position < first + mtree_fanout && position < size; position++) {
+        local_id dst = member_at(root, proc->num_process, position);
+        if (send_frame(proc, dst, frame) != 0) {
+            fprintf(stderr, "Process %d: tree multicast of %d to %d failed\n", proc->pid, root, dst);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int mtree_send(Process* proc, const MessageFrame* frame) {
+    SmallMessage small;
+    MessageFrame* tagged = message_acquire(&small, frame->s_header.s_payload_len);
+    if (tagged == NULL) {
+        return -1;
+    }
+    memcpy(tagged, frame, sizeof(MessageHeader) + frame->s_header.s_payload_len);
+    tagged->s_header.s_type = message_with_root(frame->s_header.s_type, proc->pid);
+
+    int status = -1;
+    if (proc->pid == PARENT_ID || send_frame(proc, PARENT_ID, tagged) == 0) {
+        status = send_to_subtree(proc, proc->pid, tagged);
+    }
+    message_release(&small, tagged);
+    return status;
+}
+
+int mtree_on_receive(Process* proc, Message* message) {
+    int root = message_root(message->s_header.s_type);
+    if (root < 0) {
+        return 0;
+    }
+    int status = 0;
+    // the parent is only ever a leaf of children's trees
+    if (proc->pid != PARENT_ID || root == PARENT_ID) {
+        status = send_to_subtree(proc, root, message_frame(message));
+    }
+    message->s_header.s_type = message_base_type(message->s_header.s_type);
+    return status;
+}
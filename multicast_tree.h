@@ -0,0 +1,30 @@
+#ifndef MULTICAST_TREE_H
+#define MULTICAST_TREE_H
+
+#include "base_vars.h"
+#include "message_pool.h"
+
+/**
+ * Spanning-tree multicast, enabled with --tree[=k]. Instead of writing to
+ * all N-1 peers, the sender writes to its k children of a k-ary tree rooted
+ * at itself, tags the message with its id and every receiver forwards it
+ * unchanged (Lamport time included) to its own children in that tree.
+ *
+ * The tree of a child spans the children only; the parent is an extra
+ * direct leaf of the root so it keeps reading STARTED and DONE from each
+ * sender's own channel. The parent's tree (STOP) spans everyone.
+ */
+extern int mtree_fanout;
+
+enum {
+    MTREE_DEFAULT_FANOUT = 2
+};
+
+void mtree_configure(int fanout);
+
+int mtree_send(Process* proc, const MessageFrame* frame);
+
+/// Forwards a tagged message down the tree and strips the tag.
+int mtree_on_receive(Process* proc, Message* message);
+
+#endif
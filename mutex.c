@@ -0,0 +1,117 @@
+#include "mutex.h"
+#include "helpers.h"
+
+
+static const MutexOps *mutex_ops = &mutex_ra_ops;
+
+static const char *const mutex_names[] = {"ra", "lamport", "sk"};
+
+void mutex_configure(MutexAlgorithm algorithm) {
+    switch (algorithm) {
+        case MUTEX_LAMPORT:
+            mutex_ops = &mutex_lamport_ops;
+            break;
+        case MUTEX_SK:
+            mutex_ops = &mutex_sk_ops;
+            break;
+        default:
+            mutex_ops = &mutex_ra_ops;
+            break;
+    }
+}
+
+int mutex_parse(const char* name, MutexAlgorithm* algorithm) {
+    for (int i = 0; i < (int) (sizeof(mutex_names) / sizeof(mutex_names[0])); i++) {
+        if (strcmp(name, mutex_names[i]) == 0) {
+            *algorithm = (MutexAlgorithm) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* mutex_name(MutexAlgorithm algorithm) {
+    return mutex_names[algorithm];
+}
+
+int mutex_is_cs_message(const Message* msg) {
+    return msg->s_header.s_type >= CS_REQUEST && msg->s_header.s_type <= CS_TOKEN;
+}
+
+int mutex_on_message(Process* proc, const Message* msg) {
+    if (msg->s_header.s_payload_len < 1) {
+        fprintf(stderr, "Error: process %d received a CS message without a sender id\n", proc->pid);
+        return -1;
+    }
+    local_id from = msg->s_payload[0];
+    if (from < 1 || from >= proc->num_process || from == proc->pid) {
+        fprintf(stderr, "Error: process %d received a CS message from unknown process %d\n", proc->pid, from);
+        return -1;
+    }
+    return mutex_ops->on_message(proc, msg);
+}
+
+static int handle_cs_message(Process* proc, const Message* msg) {
+    lmprd_time_update(msg->s_header.s_local_time);
+    return mutex_on_message(proc, msg);
+}
+
+static int replay_deferred(Process* proc) {
+    for (int pending = deferred_pending(); pending > 0; pending--) {
+        Message msg;
+        take_deferred(&msg);
+        int status = mutex_is_cs_message(&msg) ? handle_cs_message(proc, &msg) : defer_message(&msg);
+        if (status != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int mutex_poll(Process* proc) {
+    if (replay_deferred(proc) != 0) {
+        return -1;
+    }
+    while (1) {
+        Message msg;
+        int status = try_receive_any(proc, &msg);
+        if (status == 1) {
+            return 0;
+        }
+        if (status != 0) {
+            fprintf(stderr, "Error: process %d failed to poll for CS messages\n", proc->pid);
+            return -1;
+        }
+        status = mutex_is_cs_message(&msg) ? handle_cs_message(proc, &msg) : defer_message(&msg);
+        if (status != 0) {
+            return -1;
+        }
+    }
+}
+
+int mutex_wait(Process* proc, int (*ready)(const Process* proc)) {
+    if (replay_deferred(proc) != 0) {
+        return -1;
+    }
+    while (!ready(proc)) {
+        Message msg;
+        if (receive_any(proc, &msg) != 0) {
+            fprintf(stderr, "Error: process %d failed to receive while waiting for the lock\n", proc->pid);
+            return -1;
+        }
+        // transfers and STOP wait for ops_commands(), like the ones deferred at STARTED
+        int status = mutex_is_cs_message(&msg) ? handle_cs_message(proc, &msg) : defer_message(&msg);
+        if (status != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int request_cs(const void* self) {
+    return mutex_ops->request((Process*) self);
+}
+
+int release_cs(const void* self) {
+    return mutex_ops->release((Process*) self);
+}
@@ -0,0 +1,67 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include "base_vars.h"
+#include "message_flags.h"
+
+/**
+ * Distributed mutual exclusion among the children, request_cs() and
+ * release_cs() of pa2345.h. The parent takes no part in it. Selected per
+ * run with --mutex=NAME:
+ *   ra       Ricart-Agrawala over the Lamport clock. A peer with an older
+ *            (time, id) request of its own defers its reply until
+ *            release_cs(): 2(N-1) messages per entry, no CS_RELEASE.
+ *   lamport  Lamport's queue: every peer replies at once and keeps the
+ *            request queued until CS_RELEASE: 3(N-1) messages per entry.
+ *   sk       Suzuki-Kasami. A single CS_TOKEN carries the last served
+ *            request number of every child and the queue of waiters; a
+ *            request is a numbered CS_REQUEST to everyone. The holder
+ *            re-enters for free, anyone else pays N-1 requests and a token.
+ *
+ * receive_any() does not tell who sent a message, so every CS_* payload
+ * starts with the sender id, followed by what the algorithm needs.
+ */
+typedef enum {
+    MUTEX_RA = 0,
+    MUTEX_LAMPORT,
+    MUTEX_SK
+} MutexAlgorithm;
+
+typedef struct {
+    int (*request)(Process* proc);
+    int (*release)(Process* proc);
+    int (*on_message)(Process* proc, const Message* msg);
+} MutexOps;
+
+extern const MutexOps mutex_ra_ops;
+extern const MutexOps mutex_lamport_ops;
+extern const MutexOps mutex_sk_ops;
+
+void mutex_configure(MutexAlgorithm algorithm);
+
+/// Returns -1 for an unknown name.
+int mutex_parse(const char* name, MutexAlgorithm* algorithm);
+
+const char* mutex_name(MutexAlgorithm algorithm);
+
+/// Handles a CS_* message received outside request_cs(), the clock already updated.
+int mutex_on_message(Process* proc, const Message* msg);
+
+int mutex_is_cs_message(const Message* msg);
+
+/// Payload of a CS_* message past the sender id.
+static inline const void* mutex_body(const Message* msg) {
+    return msg->s_payload + 1;
+}
+
+/**
+ * Receives until ready() holds. CS_* messages are handled on the way, the
+ * rest waits in the deferred ring for ops_commands(). Requests deferred
+ * while STARTED was collected are answered first.
+ */
+int mutex_wait(Process* proc, int (*ready)(const Process* proc));
+
+/// Handles what has already arrived like mutex_wait(), without blocking.
+int mutex_poll(Process* proc);
+
+#endif
@@ -0,0 +1,64 @@
+#include "mutex.h"
+#include "helpers.h"
+
+
+/// Request queue of Lamport's algorithm, at most one pending request per child.
+static int queued[MAX_PROCESS_ID + 1];
+static timestamp_t queued_time[MAX_PROCESS_ID + 1];
+static int replies_missing = 0;
+
+static int lamport_on_message(Process* proc, const Message* msg) {
+    local_id from = msg->s_payload[0];
+    switch (msg->s_header.s_type) {
+        case CS_REQUEST:
+            queued[from] = 1;
+            queued_time[from] = msg->s_header.s_local_time;
+            return mess_cs_to(proc, CS_REPLY, from, NULL, 0);
+        case CS_REPLY:
+            replies_missing--;
+            return 0;
+        case CS_RELEASE:
+            queued[from] = 0;
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+/// Every peer replied and no queued request is older than ours, ties going to the lower id.
+static int lamport_ready(const Process* proc) {
+    if (replies_missing > 0) {
+        return 0;
+    }
+    timestamp_t own_time = queued_time[proc->pid];
+    for (local_id id = 1; id < proc->num_process; id++) {
+        if (id == proc->pid || !queued[id]) {
+            continue;
+        }
+        if (queued_time[id] < own_time || (queued_time[id] == own_time && id < proc->pid)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int lamport_request(Process* proc) {
+    replies_missing = proc->num_process - 2;
+    if (mess_cs_multicast(proc, CS_REQUEST, NULL, 0) != 0) {
+        return -1;
+    }
+    queued[proc->pid] = 1;
+    queued_time[proc->pid] = get_lamport_time();
+    return mutex_wait(proc, lamport_ready);
+}
+
+static int lamport_release(Process* proc) {
+    queued[proc->pid] = 0;
+    return mess_cs_multicast(proc, CS_RELEASE, NULL, 0);
+}
+
+const MutexOps mutex_lamport_ops = {
+    .request = lamport_request,
+    .release = lamport_release,
+    .on_message = lamport_on_message
+};
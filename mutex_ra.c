@@ -0,0 +1,64 @@
+#include "mutex.h"
+#include "helpers.h"
+
+
+static int requesting = 0;
+static timestamp_t request_time = 0;
+static int replies_missing = 0;
+static int reply_deferred[MAX_PROCESS_ID + 1];
+
+/// Lamport's total order: the older request wins, ties go to the lower id.
+static int precedes(timestamp_t time, local_id id, timestamp_t other_time, local_id other_id) {
+    return time < other_time || (time == other_time && id < other_id);
+}
+
+static int ra_on_message(Process* proc, const Message* msg) {
+    local_id from = msg->s_payload[0];
+    switch (msg->s_header.s_type) {
+        case CS_REQUEST:
+            if (requesting && precedes(request_time, proc->pid, msg->s_header.s_local_time, from)) {
+                reply_deferred[from] = 1;
+                return 0;
+            }
+            return mess_cs_to(proc, CS_REPLY, from, NULL, 0);
+        case CS_REPLY:
+            replies_missing--;
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+static int ra_ready(const Process* proc) {
+    (void) proc;
+    return replies_missing == 0;
+}
+
+static int ra_request(Process* proc) {
+    requesting = 1;
+    replies_missing = proc->num_process - 2;
+    if (mess_cs_multicast(proc, CS_REQUEST, NULL, 0) != 0) {
+        return -1;
+    }
+    request_time = get_lamport_time();
+    return mutex_wait(proc, ra_ready);
+}
+
+static int ra_release(Process* proc) {
+    requesting = 0;
+    for (local_id id = 1; id < proc->num_process; id++) {
+        if (reply_deferred[id]) {
+            reply_deferred[id] = 0;
+            if (mess_cs_to(proc, CS_REPLY, id, NULL, 0) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+const MutexOps mutex_ra_ops = {
+    .request = ra_request,
+    .release = ra_release,
+    .on_message = ra_on_message
+};
@@ -0,0 +1,105 @@
+#include "mutex.h"
+#include "helpers.h"
+
+
+/// Body of CS_TOKEN: the last served request of every child and the waiters in order.
+typedef struct {
+    int32_t  t_served[MAX_PROCESS_ID + 1];
+    uint8_t  t_queue_len;
+    local_id t_queue[MAX_PROCESS_ID];
+} __attribute__((packed)) MutexToken;
+
+static int initialized = 0;
+static int have_token = 0;
+static int wanted = 0;      ///< from request_cs() to release_cs(), the token stays
+static int32_t requested[MAX_PROCESS_ID + 1];
+static MutexToken token;
+
+/// Child 1 starts with the token.
+static void sk_init(const Process* proc) {
+    if (initialized) {
+        return;
+    }
+    initialized = 1;
+    have_token = proc->pid == 1;
+    memset(requested, 0, sizeof(requested));
+    memset(&token, 0, sizeof(token));
+}
+
+static int is_waiting(local_id id) {
+    return requested[id] == token.t_served[id] + 1;
+}
+
+static int send_token(Process* proc, local_id dst) {
+    have_token = 0;
+    return mess_cs_to(proc, CS_TOKEN, dst, &token, sizeof(token));
+}
+
+static int sk_on_message(Process* proc, const Message* msg) {
+    sk_init(proc);
+    local_id from = msg->s_payload[0];
+    switch (msg->s_header.s_type) {
+        case CS_REQUEST: {
+            int32_t number;
+            memcpy(&number, mutex_body(msg), sizeof(number));
+            if (number > requested[from]) {
+                requested[from] = number;
+            }
+            if (have_token && !wanted && is_waiting(from)) {
+                return send_token(proc, from);
+            }
+            return 0;
+        }
+        case CS_TOKEN:
+            memcpy(&token, mutex_body(msg), sizeof(token));
+            have_token = 1;
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+static int sk_ready(const Process* proc) {
+    (void) proc;
+    return have_token;
+}
+
+/// A holder serves the requests that already arrived before it re-enters.
+static int sk_request(Process* proc) {
+    sk_init(proc);
+    if (have_token && mutex_poll(proc) != 0) {
+        return -1;
+    }
+    wanted = 1;
+    if (!have_token) {
+        int32_t number = ++requested[proc->pid];
+        if (mess_cs_multicast(proc, CS_REQUEST, &number, sizeof(number)) != 0) {
+            return -1;
+        }
+    }
+    return mutex_wait(proc, sk_ready);
+}
+
+/// Queues every child with an outstanding request and hands the token to the first one.
+static int sk_release(Process* proc) {
+    wanted = 0;
+    token.t_served[proc->pid] = requested[proc->pid];
+    for (local_id id = 1; id < proc->num_process; id++) {
+        if (id == proc->pid || !is_waiting(id) || memchr(token.t_queue, id, token.t_queue_len) != NULL) {
+            continue;
+        }
+        token.t_queue[token.t_queue_len++] = id;
+    }
+    if (token.t_queue_len == 0) {
+        return 0;
+    }
+    local_id next = token.t_queue[0];
+    memmove(token.t_queue, token.t_queue + 1, --token.t_queue_len);
+    return send_token(proc, next);
+}
+
+const MutexOps mutex_sk_ops = {
+    .request = sk_request,
+    .release = sk_release,
+    .on_message = sk_on_message
+};
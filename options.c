@@ -0,0 +1,124 @@
+#include "options.h"
+#include "live_stats.h"
+#include "trace.h"
+#include "multicast_tree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static int is_long_option(const char *arg) {
+    return strncmp(arg, "--", 2) == 0;
+}
+
+static int apply_option(const char *arg, RunOptions *options) {
+    if (strcmp(arg, "--stats") == 0) {
+        options->print_stats = 1;
+        return 0;
+    }
+    if (strcmp(arg, "--live") == 0) {
+        options->live_stats_path = live_stats_default_path;
+        return 0;
+    }
+    if (strncmp(arg, "--live=", 7) == 0 && arg[7] != '\0') {
+        options->live_stats_path = arg + 7;
+        return 0;
+    }
+    if (strcmp(arg, "--trace") == 0) {
+        options->trace_prefix = trace_default_prefix;
+        return 0;
+    }
+    if (strncmp(arg, "--trace=", 8) == 0 && arg[8] != '\0') {
+        options->trace_prefix = arg + 8;
+        return 0;
+    }
+    if (strcmp(arg, "--tree") == 0) {
+        options->multicast_fanout = MTREE_DEFAULT_FANOUT;
+        return 0;
+    }
+    if (strncmp(arg, "--tree=", 7) == 0 && atoi(arg + 7) > 0) {
+        options->multicast_fanout = atoi(arg + 7);
+        return 0;
+    }
+    if (strcmp(arg, "--barrier") == 0) {
+        options->shm_barrier = 1;
+        return 0;
+    }
+    if (strcmp(arg, "--zero-copy") == 0) {
+        options->zero_copy = 1;
+        return 0;
+    }
+    if (strcmp(arg, "--mutexl") == 0) {
+        options->mutexl = 1;
+        return 0;
+    }
+    if (strcmp(arg, "--snapshot") == 0) {
+        options->snapshot = 1;
+        return 0;
+    }
+    if (strncmp(arg, "--snapshot=", 11) == 0 && atoi(arg + 11) > 0) {
+        options->snapshot = 1;
+        options->snapshot_every = atoi(arg + 11);
+        return 0;
+    }
+    if (strncmp(arg, "--timeout=", 10) == 0 && atof(arg + 10) > 0) {
+        options->timeout_ms = (int) (atof(arg + 10) * 1000);
+        return 0;
+    }
+    if (strncmp(arg, "--mutex=", 8) == 0) {
+        return mutex_parse(arg + 8, &options->mutex);
+    }
+    if (strcmp(arg, "--profile") == 0) {
+        options->profile_format = PROFILE_TEXT;
+        return 0;
+    }
+    if (strcmp(arg, "--profile=json") == 0) {
+        options->profile_format = PROFILE_JSON;
+        return 0;
+    }
+    return -1;
+}
+
+void parse_run_options(int *argc, char *argv[], RunOptions *options) {
+    memset(options, 0, sizeof(RunOptions));
+
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        if (!is_long_option(argv[i])) {
+            argv[kept++] = argv[i];
+            continue;
+        }
+        if (apply_option(argv[i], options) != 0) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            exit(1);
+        }
+    }
+    argv[kept] = NULL;
+    *argc = kept;
+
+    if (options->shm_barrier && options->trace_prefix != NULL) {
+        // the barrier leaves no STARTED/DONE messages for pa_replay to feed back
+        fprintf(stderr, "--barrier cannot be combined with --trace\n");
+        exit(1);
+    }
+    if (options->zero_copy && options->trace_prefix != NULL) {
+        // the sent records would hold slot descriptors instead of messages
+        fprintf(stderr, "--zero-copy cannot be combined with --trace\n");
+        exit(1);
+    }
+    if (options->snapshot && options->trace_prefix != NULL) {
+        // pa_replay would be fed markers that no process of the replay sends
+        fprintf(stderr, "--snapshot cannot be combined with --trace\n");
+        exit(1);
+    }
+    if (options->mutexl && options->shm_barrier) {
+        // a child blocked on the DONE futex could no longer answer CS_REQUESTs
+        fprintf(stderr, "--mutexl cannot be combined with --barrier\n");
+        exit(1);
+    }
+    if (options->mutexl && options->trace_prefix != NULL) {
+        // pa_replay knows nothing about the lock traffic
+        fprintf(stderr, "--mutexl cannot be combined with --trace\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "profiler.h"
+#include "mutex.h"
+
+/**
+ * Optional long flags of pa_program. They may appear anywhere on the command
+ * line and are removed from argv before the "-p X balances..." positional
+ * arguments are checked.
+ */
+typedef struct {
+    int print_stats;    ///< --stats: per-channel IPC counters at the end of the run
+    ProfileFormat profile_format;   ///< --profile or --profile=json: phase timings
+    const char *live_stats_path;    ///< --live[=path]: shared page for tools/pa_top
+    const char *trace_prefix;       ///< --trace[=prefix]: per-process binary message traces
+    int multicast_fanout;           ///< --tree[=k]: k-ary spanning-tree multicast, 0 for direct
+    int shm_barrier;                ///< --barrier: STARTED and DONE through shared memory
+    int zero_copy;                  ///< --zero-copy: multicast payloads through shared slots
+    int mutexl;                     ///< --mutexl: children print their loop under request_cs()
+    int snapshot;                   ///< --snapshot[=k]: Chandy-Lamport snapshots on SIGUSR1
+    int snapshot_every;             ///< and every k transfers, 0 for SIGUSR1 only
+    int timeout_ms;                 ///< --timeout=s: longest wait of a receive, 0 for no limit
+    MutexAlgorithm mutex;           ///< --mutex=ra|lamport|sk: algorithm behind request_cs()
+} RunOptions;
+
+void parse_run_options(int *argc, char *argv[], RunOptions *options);
+
+#endif
@@ -0,0 +1,179 @@
+#define _DEFAULT_SOURCE
+
+#include "out_queue.h"
+#include "ipc_stats.h"
+#include "liveness.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+typedef struct {
+    int    q_fd;
+    char*  q_data;
+    size_t q_start;     ///< first byte of the oldest unsent frame
+    size_t q_len;       ///< bytes of whole unsent frames
+    size_t q_cap;
+} OutQueue;
+
+enum {
+    OUT_QUEUE_MIN_CAP = 4 * MAX_MESSAGE_LEN
+};
+
+static OutQueue queues[MAX_PROCESS_ID + 1];
+static size_t pending_bytes = 0;
+
+static int append(OutQueue *queue, const char *data, size_t len) {
+    if (queue->q_start + queue->q_len + len > queue->q_cap) {
+        memmove(queue->q_data, queue->q_data + queue->q_start, queue->q_len);
+        queue->q_start = 0;
+    }
+    if (queue->q_len + len > queue->q_cap) {
+        size_t cap = queue->q_cap ? queue->q_cap : OUT_QUEUE_MIN_CAP;
+        while (cap < queue->q_len + len) {
+            cap *= 2;
+        }
+        char *data_grown = realloc(queue->q_data, cap);
+        if (data_grown == NULL) {
+            perror("Failed to grow an outbound queue");
+            return -1;
+        }
+        queue->q_data = data_grown;
+        queue->q_cap = cap;
+    }
+    memcpy(queue->q_data + queue->q_start + queue->q_len, data, len);
+    queue->q_len += len;
+    pending_bytes += len;
+    return 0;
+}
+
+static void consume(OutQueue *queue, size_t len) {
+    queue->q_start += len;
+    queue->q_len -= len;
+    pending_bytes -= len;
+    if (queue->q_len == 0) {
+        queue->q_start = 0;
+    }
+}
+
+static size_t queued_frame_len(const OutQueue *queue) {
+    MessageHeader header;
+    memcpy(&header, queue->q_data + queue->q_start, sizeof(header));
+    return sizeof(MessageHeader) + header.s_payload_len;
+}
+
+/*
+ * One write() per frame, so that the runtime's write() sees every frame
+ * whole. A frame is at most MAX_MESSAGE_LEN == PIPE_BUF bytes, so a write
+ * to the non-blocking pipe either takes all of it or fails with EAGAIN.
+ * Returns 1 when the pipe is full, 0 when the frame went out.
+ */
+static int write_frame(int fd, const void *frame, size_t frame_len) {
+    ssize_t written = write(fd, frame, frame_len);
+    ipc_stats.syscalls++;
+    if (written < 0) {
+        if (errno != EAGAIN) {
+            return -1;
+        }
+        ipc_stats.eagain_spins++;
+        return 1;
+    }
+    if ((size_t) written != frame_len) {
+        ipc_stats.short_writes++;
+        fprintf(stderr, "Error: short write of a %zu byte frame to fd %d\n", frame_len, fd);
+        return -1;
+    }
+    return 0;
+}
+
+/// Sends the queued frames in order until the pipe is full, returns 1 if some are left.
+static int write_queued(OutQueue *queue) {
+    while (queue->q_len > 0) {
+        size_t frame_len = queued_frame_len(queue);
+        int status = write_frame(queue->q_fd, queue->q_data + queue->q_start, frame_len);
+        if (status != 0) {
+            return status;
+        }
+        consume(queue, frame_len);
+    }
+    return 0;
+}
+
+int out_queue_send(int fd, local_id dst, const void *frame, size_t frame_len) {
+    OutQueue *queue = &queues[dst];
+    queue->q_fd = fd;
+    int status = write_queued(queue);
+    if (status == 0) {
+        status = write_frame(fd, frame, frame_len);
+    }
+    if (status < 0) {
+        return -1;
+    }
+    if (status > 0) {
+        return append(queue, frame, frame_len);
+    }
+    return 0;
+}
+
+size_t out_queue_pending(void) {
+    return pending_bytes;
+}
+
+int out_queue_flush(void) {
+    for (int dst = 0; pending_bytes > 0 && dst <= MAX_PROCESS_ID; dst++) {
+        if (queues[dst].q_len > 0 && write_queued(&queues[dst]) < 0) {
+            perror("Failed to flush an outbound queue");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int out_queue_drain(local_id self) {
+    uint64_t deadline_ns = liveness_deadline();
+    while (pending_bytes > 0) {
+        if (out_queue_flush() != 0) {
+            return -1;
+        }
+        struct pollfd waiting[MAX_PROCESS_ID + 1];
+        nfds_t count = 0;
+        for (int dst = 0; dst <= MAX_PROCESS_ID; dst++) {
+            if (queues[dst].q_len > 0) {
+                waiting[count].fd = queues[dst].q_fd;
+                waiting[count++].events = POLLOUT;
+            }
+        }
+        int slice_ms = LIVENESS_SLICE_MS;
+        if (deadline_ns != 0) {
+            uint64_t now_ns = liveness_now_ns();
+            if (now_ns >= deadline_ns) {
+                fprintf(stderr, "Error: process %d timed out with %zu bytes left to send\n", self, pending_bytes);
+                return -1;
+            }
+            if ((deadline_ns - now_ns) / 1000000 < (uint64_t) slice_ms) {
+                slice_ms = (deadline_ns - now_ns) / 1000000 + 1;
+            }
+        }
+        int ready = poll(waiting, count, slice_ms);
+        if (ready < 0 && errno != EINTR) {
+            perror("Failed to wait for a writable pipe");
+            return -1;
+        }
+        // a peer that is gone never reads its pipe empty
+        if (ready == 0 && liveness_check(self) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void out_queue_reset(void) {
+    for (int dst = 0; dst <= MAX_PROCESS_ID; dst++) {
+        queues[dst].q_start = 0;
+        queues[dst].q_len = 0;
+    }
+    pending_bytes = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef OUT_QUEUE_H
+#define OUT_QUEUE_H
+
+#include <stddef.h>
+
+#include "ipc.h"
+
+/**
+ * Outbound frames of one process, one queue per destination. send() first
+ * writes whatever is queued for the channel, then the new frame, each
+ * frame with its own write(). A frame the pipe does not take (EAGAIN) is
+ * kept whole and flushed from the receive loops, so a full pipe delays a
+ * frame instead of dropping or truncating it.
+ */
+int out_queue_send(int fd, local_id dst, const void *frame, size_t frame_len);
+
+/// Bytes accepted by out_queue_send() that are not in a pipe yet.
+size_t out_queue_pending(void);
+
+/// Writes as much of every queue as the pipes take without blocking.
+int out_queue_flush(void);
+
+/// Waits until every queue is empty, before the write ends are closed.
+/// Fails when a process is gone or the --timeout deadline passes, like a receive.
+int out_queue_drain(local_id self);
+
+/// Drops what is queued and forgets the fds, between two runs.
+void out_queue_reset(void);
+
+#endif
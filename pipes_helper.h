@@ -9,6 +9,7 @@ void drop_pipes_that_out(Process* processes, FILE* pipe_file_ptr);
 
 void drop_pipes_that_in(Process* processes, FILE* pipe_file_ptr);
 
+/// Closes every fd of the pipe matrix outside the channel table, bind_channels() must have run.
 void drop_pipes_that_non_rel(Process* process, FILE* pipe_file_ptr);
 
 #endif
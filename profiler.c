@@ -0,0 +1,179 @@
+#define _DEFAULT_SOURCE
+
+#include "profiler.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "startup", "started_barrier", "transfers", "shutdown", "history"
+};
+
+static PhaseProfile profile;
+static int current_phase = -1;
+static uint64_t phase_wall_start = 0;
+static uint64_t phase_cpu_start = 0;
+
+static uint64_t clock_ns(clockid_t clock_id) {
+    struct timespec now;
+    clock_gettime(clock_id, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+PhaseProfileTable* profiler_table_create(void) {
+    PhaseProfileTable* table = mmap(NULL, sizeof(PhaseProfileTable), PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) {
+        perror("Failed to map phase profile table");
+        return NULL;
+    }
+    return table;
+}
+
+void profiler_table_destroy(PhaseProfileTable* table) {
+    if (table != NULL) {
+        munmap(table, sizeof(PhaseProfileTable));
+    }
+}
+
+static void close_current_phase(uint64_t wall_now, uint64_t cpu_now) {
+    if (current_phase < 0) {
+        return;
+    }
+    profile.wall_ns[current_phase] += wall_now - phase_wall_start;
+    profile.cpu_ns[current_phase] += cpu_now - phase_cpu_start;
+}
+
+void profiler_start(void) {
+    memset(&profile, 0, sizeof(profile));
+    current_phase = PHASE_STARTUP;
+    phase_wall_start = clock_ns(CLOCK_MONOTONIC);
+    phase_cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void profiler_forked(void) {
+    // the CPU clock of a new process starts from zero, the wall clock is kept
+    // so the child startup phase includes pipe creation and fork()
+    phase_cpu_start = 0;
+}
+
+void profiler_enter(ProfilePhase phase) {
+    uint64_t wall_now = clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu_now = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    close_current_phase(wall_now, cpu_now);
+    current_phase = phase;
+    phase_wall_start = wall_now;
+    phase_cpu_start = cpu_now;
+}
+
+void profiler_publish(PhaseProfileTable* table, local_id id) {
+    close_current_phase(clock_ns(CLOCK_MONOTONIC), clock_ns(CLOCK_PROCESS_CPUTIME_ID));
+    current_phase = -1;
+    if (table == NULL) {
+        return;
+    }
+    memcpy(&table->processes[id], &profile, sizeof(PhaseProfile));
+    __atomic_store_n(&table->processes[id].published, 1, __ATOMIC_RELEASE);
+}
+
+static double to_ms(uint64_t ns) {
+    return ns / 1e6;
+}
+
+static int is_published(const PhaseProfileTable* table, int id) {
+    return __atomic_load_n(&table->processes[id].published, __ATOMIC_ACQUIRE);
+}
+
+static void report_text(const PhaseProfileTable* table, int num_process, FILE* output) {
+    fprintf(output, "=== Phase profile (wall ms / cpu ms) ===\n");
+    fprintf(output, "%-8s", "process");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(output, " %21s", phase_names[phase]);
+    }
+    fprintf(output, "\n");
+
+    double max_wall[PHASE_COUNT] = {0};
+    double sum_cpu[PHASE_COUNT] = {0};
+    for (int id = 0; id < num_process; id++) {
+        if (!is_published(table, id)) {
+            fprintf(output, "%-8d n/a\n", id);
+            continue;
+        }
+        const PhaseProfile* entry = &table->processes[id];
+        fprintf(output, "%-8d", id);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            double wall = to_ms(entry->wall_ns[phase]);
+            double cpu = to_ms(entry->cpu_ns[phase]);
+            fprintf(output, " %10.3f/%10.3f", wall, cpu);
+            if (wall > max_wall[phase]) {
+                max_wall[phase] = wall;
+            }
+            sum_cpu[phase] += cpu;
+        }
+        fprintf(output, "\n");
+    }
+    fprintf(output, "%-8s", "max/sum");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(output, " %10.3f/%10.3f", max_wall[phase], sum_cpu[phase]);
+    }
+    fprintf(output, "\n");
+}
+
+static void report_json(const PhaseProfileTable* table, int num_process, FILE* output) {
+    fprintf(output, "{\"processes\": %d, \"phases\": [", num_process);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(output, "%s\"%s\"", phase ? ", " : "", phase_names[phase]);
+    }
+    fprintf(output, "], \"profile\": [");
+    int first = 1;
+    for (int id = 0; id < num_process; id++) {
+        if (!is_published(table, id)) {
+            continue;
+        }
+        const PhaseProfile* entry = &table->processes[id];
+        fprintf(output, "%s{\"id\": %d, \"wall_ns\": [", first ? "" : ", ", id);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            fprintf(output, "%s%llu", phase ? ", " : "", (unsigned long long) entry->wall_ns[phase]);
+        }
+        fprintf(output, "], \"cpu_ns\": [");
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            fprintf(output, "%s%llu", phase ? ", " : "", (unsigned long long) entry->cpu_ns[phase]);
+        }
+        fprintf(output, "]}");
+        first = 0;
+    }
+    fprintf(output, "]}\n");
+}
+
+void profiler_totals(const PhaseProfileTable* table, int num_process, uint64_t* max_wall_ns, uint64_t* sum_cpu_ns) {
+    memset(max_wall_ns, 0, PHASE_COUNT * sizeof(uint64_t));
+    memset(sum_cpu_ns, 0, PHASE_COUNT * sizeof(uint64_t));
+    if (table == NULL) {
+        return;
+    }
+    for (int id = 0; id < num_process; id++) {
+        if (!is_published(table, id)) {
+            continue;
+        }
+        const PhaseProfile* entry = &table->processes[id];
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            if (entry->wall_ns[phase] > max_wall_ns[phase]) {
+                max_wall_ns[phase] = entry->wall_ns[phase];
+            }
+            sum_cpu_ns[phase] += entry->cpu_ns[phase];
+        }
+    }
+}
+
+void profiler_report(const PhaseProfileTable* table, int num_process, ProfileFormat format, FILE* output) {
+    if (table == NULL || format == PROFILE_OFF) {
+        return;
+    }
+    if (format == PROFILE_JSON) {
+        report_json(table, num_process, output);
+    } else {
+        report_text(table, num_process, output);
+    }
+    fflush(output);
+}
@@ -0,0 +1,50 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ipc.h"
+
+typedef enum {
+    PHASE_STARTUP = 0,      ///< create_pipes, fork, drop_pipes_that_non_rel
+    PHASE_STARTED_BARRIER,  ///< STARTED multicast and is_every_get(STARTED)
+    PHASE_TRANSFERS,        ///< bank_robbery in the parent, TRANSFER handling in children
+    PHASE_SHUTDOWN,         ///< STOP and DONE exchange
+    PHASE_HISTORY,          ///< BALANCE_HISTORY exchange and chronicle()
+    PHASE_COUNT
+} ProfilePhase;
+
+typedef struct {
+    uint64_t wall_ns[PHASE_COUNT];
+    uint64_t cpu_ns[PHASE_COUNT];
+    uint8_t  published;
+} PhaseProfile;
+
+typedef struct {
+    PhaseProfile processes[MAX_PROCESS_ID + 1];
+} PhaseProfileTable;
+
+typedef enum {
+    PROFILE_OFF = 0,
+    PROFILE_TEXT,
+    PROFILE_JSON
+} ProfileFormat;
+
+PhaseProfileTable* profiler_table_create(void);
+
+void profiler_table_destroy(PhaseProfileTable* table);
+
+void profiler_start(void);
+
+void profiler_forked(void);
+
+void profiler_enter(ProfilePhase phase);
+
+void profiler_publish(PhaseProfileTable* table, local_id id);
+
+void profiler_totals(const PhaseProfileTable* table, int num_process, uint64_t* max_wall_ns, uint64_t* sum_cpu_ns);
+
+void profiler_report(const PhaseProfileTable* table, int num_process, ProfileFormat format, FILE* output);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef RUN_SHARED_H
+#define RUN_SHARED_H
+
+#include "shared_log.h"
+#include "ipc_stats.h"
+#include "options.h"
+#include "profiler.h"
+#include "live_stats.h"
+#include "shm_barrier.h"
+#include "msg_slots.h"
+
+/**
+ * Regions mapped by the parent before fork() and inherited by every child,
+ * plus the options of the run.
+ */
+typedef struct {
+    RunOptions     options;
+    SharedLog*     events;
+    IpcStatsTable* ipc_stats;
+    PhaseProfileTable* profile;
+    LiveStatsPage* live;
+    ShmBarrier*    barrier;     ///< NULL unless --barrier
+    MessageSlotArena* slots;    ///< NULL unless --zero-copy
+} RunShared;
+
+#endif
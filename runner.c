@@ -0,0 +1,457 @@
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <asm-generic/errno.h>
+
+
+#include "helpers.h"
+#include "common.h"
+#include "pipes_helper.h"
+#include "event_log.h"
+#include "run_shared.h"
+#include "runner.h"
+#include "tracepoints.h"
+#include "trace.h"
+#include "multicast_tree.h"
+#include "out_queue.h"
+#include "flow_control.h"
+#include "message_pool.h"
+#include "mutex.h"
+#include "snapshot.h"
+#include "liveness.h"
+
+void finish_snapshot(void *parent_data);
+
+void send_transfer_message(void *context_data, local_id initiator, local_id recipient, balance_t transfer_amount) {
+    TransferOrder transfer_info;
+    transfer_info.s_src = initiator;
+    transfer_info.s_dst = recipient;
+    transfer_info.s_amount = transfer_amount;
+    lmprd_time_upgrade();
+    mess_to(context_data, TRANSFER, &transfer_info);
+}
+
+int receive_acknowledgement(void *context_data, local_id recipient, Message *ack_message) {
+    int ack_status = receive(context_data, recipient, ack_message);
+    if (ack_status != 0) {
+        fprintf(stderr, "Ошибка: подтверждение от процесса %d не получено\n", recipient);
+        exit(EXIT_FAILURE);
+    }
+    return ack_status;
+}
+
+void transfer(void *context_data, local_id initiator, local_id recipient, balance_t transfer_amount) {
+    if (snapshot_poll(context_data) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    TRACE_TRANSFER_START(get_lamport_time(), initiator, recipient, transfer_amount);
+    live_stats_set_pending(1);
+    send_transfer_message(context_data, initiator, recipient, transfer_amount);
+    Message ack_message;
+    receive_acknowledgement(context_data, recipient, &ack_message);
+    lmprd_time_update(ack_message.s_header.s_local_time);
+    live_stats_set_pending(0);
+    live_stats_tick(context_data, get_lamport_time());
+    TRACE_TRANSFER_ACK(get_lamport_time(), initiator, recipient, transfer_amount);
+}
+
+SharedLog* open_shared_event_log(uint32_t capacity) {
+    SharedLog* events_shared = shared_log_create("events.bin", capacity ? capacity : SHARED_LOG_DEFAULT_CAPACITY);
+    if (events_shared == NULL) {
+        exit(1);
+    }
+    return events_shared;
+}
+
+void init_log_files(FILE **log_pipes, FILE **log_events) {
+    *log_pipes = fopen("pipes.log", "w+");
+    if (!*log_pipes) {
+        perror("Failed to open pipes.log");
+        exit(1);
+    }
+    *log_events = fopen("events.log", "w+");
+    if (!*log_events) {
+        perror("Failed to open events.log");
+        fclose(*log_pipes);
+        exit(1);
+    }
+}
+
+void initialize_child_process(Process *child_proc, int i, int num_processes, Pipe **pipes, const int *balances) {
+    child_proc->num_process = num_processes;
+    child_proc->pipes = pipes;
+    child_proc->pid = i;
+    child_proc->cur_balance = balances[i - 1];
+    child_proc->history.s_id = i;
+    child_proc->history.s_history_len = 0;
+}
+
+void log_child_start(Process *child_proc, int i) {
+    update_chronicle(&(child_proc->history), get_lamport_time(), child_proc->cur_balance, 0);
+    mess_to(child_proc, STARTED, NULL);
+    evlog_push_started(i, get_lamport_time(), child_proc->cur_balance, getpid(), getppid());
+}
+
+void check_child_start(Process *child_proc, int i) {
+    if (is_every_get(child_proc, STARTED) != 0) {
+        fprintf(stderr, "Error: Process %d failed to receive all STARTED messages\n", i);
+        exit(EXIT_FAILURE);
+    }
+    evlog_push(EV_RECEIVED_ALL_STARTED, i, 0, get_lamport_time(), 0);
+}
+
+void perform_bank_operations(Process *child_proc) {
+    ops_commands(child_proc);
+}
+
+void close_child_pipes(Process *child_proc, FILE *log_pipes) {
+    if (out_queue_drain(child_proc->pid) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    drop_pipes_that_out(child_proc, log_pipes);
+    drop_pipes_that_in(child_proc, log_pipes);
+}
+
+void open_trace(const RunShared *shared, local_id id, int num_processes, balance_t initial_balance) {
+    if (shared->options.trace_prefix != NULL && trace_open(shared->options.trace_prefix, id, num_processes, initial_balance) != 0) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+void handle_child_process(int i, int num_processes, Pipe **pipes, const RunConfig *config, FILE *log_pipes, RunShared *shared) {
+    const int *balances = config->balances;
+    profiler_forked();
+    liveness_watch_parent();
+    evlog_init(shared->events);
+    open_trace(shared, i, num_processes, balances[i - 1]);
+    Process child_proc;
+    initialize_child_process(&child_proc, i, num_processes, pipes, balances);
+    bind_channels(&child_proc);
+    live_stats_bind(shared->live, i);
+    live_stats_publish(&child_proc, get_lamport_time());
+
+    drop_pipes_that_non_rel(&child_proc, log_pipes);
+    profiler_enter(PHASE_STARTED_BARRIER);
+    log_child_start(&child_proc, i);
+    check_child_start(&child_proc, i);
+    profiler_enter(PHASE_TRANSFERS);
+
+    if (config->child_workload != NULL) {
+        config->child_workload(&child_proc, config->child_workload_arg);
+    }
+    perform_bank_operations(&child_proc);
+    close_child_pipes(&child_proc, log_pipes);
+    evlog_flush();
+    trace_close();
+    ipc_stats_publish(shared->ipc_stats, i);
+    profiler_publish(shared->profile, i);
+    live_stats_publish(&child_proc, get_lamport_time());
+
+    exit(EXIT_SUCCESS);
+}
+
+void create_child_processes(int num_processes, Pipe **pipes, const RunConfig *config, FILE *log_pipes, RunShared *shared) {
+    fflush(log_pipes);
+    fflush(stdout);
+    for (local_id i = 1; i < num_processes; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Fork failed");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            handle_child_process(i, num_processes, pipes, config, log_pipes, shared);
+        }
+        liveness_watch_child(i, pid);
+    }
+}
+
+void wait_for_children() {
+    while (wait(NULL) > 0);
+}
+
+void cleanup(FILE *log_pipes, FILE *log_events) {
+    fclose(log_pipes);
+    fclose(log_events);
+}
+
+void initialize_log_files(FILE **log_pipes, FILE **log_events) {
+    init_log_files(log_pipes, log_events);
+}
+
+Pipe** initialize_pipes(int num_processes, FILE *log_pipes) {
+    return create_pipes(num_processes, log_pipes);
+}
+
+void create_child_processes_and_handle_pipes(int num_processes, Pipe **pipes, const RunConfig *config, FILE *log_pipes, RunShared *shared) {
+    create_child_processes(num_processes, pipes, config, log_pipes, shared);
+}
+
+int verify_received_messages(Process *parent_proc, FILE *log_pipes, MessageType expected_type, FILE *log_events) {
+    if (is_every_get(parent_proc, expected_type) != 0) {
+        fprintf(stderr, "Error: Parent process failed to receive all %s messages\n", (expected_type == STARTED) ? "STARTED" : "DONE");
+        cleanup(log_pipes, log_events);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+void handle_parent_process_logic(Process *parent_proc, const RunConfig *config, FILE *log_events, FILE *log_pipes) {
+    evlog_push(EV_RECEIVED_ALL_STARTED, PARENT_ID, 0, get_lamport_time(), 0);
+    profiler_enter(PHASE_TRANSFERS);
+    config->workload(parent_proc, config->workload_arg);
+    profiler_enter(PHASE_SHUTDOWN);
+    finish_snapshot(parent_proc);
+    mess_to(parent_proc, STOP, NULL);
+
+    verify_received_messages(parent_proc, log_pipes, DONE, log_events);
+    evlog_push(EV_RECEIVED_ALL_DONE, PARENT_ID, 0, get_lamport_time(), 0);
+    evlog_flush();
+
+    profiler_enter(PHASE_HISTORY);
+    chronicle(parent_proc, config->print_history);
+}
+
+void merge_event_log(SharedLog *events_shared, FILE *log_events) {
+    shared_log_write_sorted(events_shared, log_events);
+    shared_log_close(events_shared);
+}
+
+void report_phase_profile(RunShared *shared, int num_processes) {
+    profiler_report(shared->profile, num_processes, shared->options.profile_format, stderr);
+}
+
+void report_ipc_stats(RunShared *shared, int num_processes) {
+    ipc_stats_publish(shared->ipc_stats, PARENT_ID);
+    if (shared->options.print_stats) {
+        ipc_stats_report(shared->ipc_stats, num_processes, stderr);
+    }
+}
+
+void collect_run_result(RunShared *shared, int num_processes, RunResult *result) {
+    if (result == NULL) {
+        return;
+    }
+    memset(result, 0, sizeof(RunResult));
+    uint64_t msgs_by_type[IPC_STATS_TYPES];
+    ipc_stats_totals(shared->ipc_stats, num_processes, msgs_by_type, &result->bytes);
+    for (int bucket = 0; bucket < IPC_STATS_TYPES; bucket++) {
+        result->messages += msgs_by_type[bucket];
+    }
+    result->transfer_messages = msgs_by_type[TRANSFER] + msgs_by_type[ACK];
+    result->cs_messages = msgs_by_type[CS_REQUEST] + msgs_by_type[CS_REPLY] + msgs_by_type[CS_RELEASE]
+                          + msgs_by_type[CS_TOKEN];
+
+    uint64_t cpu_ns[PHASE_COUNT];
+    profiler_totals(shared->profile, num_processes, result->phase_wall_ns, cpu_ns);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        result->cpu_ns += cpu_ns[phase];
+    }
+    result->transfer_cpu_ns = cpu_ns[PHASE_TRANSFERS];
+}
+
+void close_pipes_and_cleanup(Process *parent_proc, FILE *log_pipes, FILE *log_events, RunShared *shared, RunResult *result) {
+    if (out_queue_drain(parent_proc->pid) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    drop_pipes_that_out(parent_proc, log_pipes);
+    drop_pipes_that_in(parent_proc, log_pipes);
+    profiler_publish(shared->profile, PARENT_ID);
+    live_stats_publish(parent_proc, get_lamport_time());
+    trace_close();
+    wait_for_children();
+    live_stats_finish(shared->live);
+    merge_event_log(shared->events, log_events);
+    report_ipc_stats(shared, parent_proc->num_process);
+    report_phase_profile(shared, parent_proc->num_process);
+    collect_run_result(shared, parent_proc->num_process, result);
+    ipc_stats_table_destroy(shared->ipc_stats);
+    profiler_table_destroy(shared->profile);
+    shm_barrier_bind(NULL);
+    shm_barrier_destroy(shared->barrier);
+    msg_slots_bind(NULL);
+    msg_slots_destroy(shared->slots);
+    cleanup(log_pipes, log_events);
+}
+
+
+/*
+ * ACKs read by transfer_issue() while it waits for a credit, handed out by
+ * transfer_poll_ack() before anything new. At most one per transfer in
+ * flight, so the credits bound them too.
+ */
+static Message **stashed_acks = NULL;
+static size_t stashed_head = 0;
+static size_t stashed_count = 0;
+static size_t stashed_capacity = 0;
+
+void stash_ack(const Message *ack_message) {
+    if (stashed_head + stashed_count == stashed_capacity) {
+        if (stashed_head > 0) {
+            memmove(stashed_acks, stashed_acks + stashed_head, stashed_count * sizeof(Message *));
+            stashed_head = 0;
+        } else {
+            stashed_capacity = stashed_capacity ? 2 * stashed_capacity : 64;
+            stashed_acks = realloc(stashed_acks, stashed_capacity * sizeof(Message *));
+        }
+    }
+    Message *copy = malloc(message_frame_len(ack_message));
+    if (stashed_acks == NULL || copy == NULL) {
+        perror("Failed to keep an ACK");
+        exit(EXIT_FAILURE);
+    }
+    message_copy(copy, ack_message);
+    stashed_acks[stashed_head + stashed_count++] = copy;
+}
+
+int take_stashed_ack(Message *ack_message) {
+    if (stashed_count == 0) {
+        return 0;
+    }
+    Message *copy = stashed_acks[stashed_head++];
+    stashed_count--;
+    message_copy(ack_message, copy);
+    free(copy);
+    if (stashed_count == 0) {
+        stashed_head = 0;
+    }
+    return 1;
+}
+
+void drop_stashed_acks(void) {
+    while (stashed_count > 0) {
+        free(stashed_acks[stashed_head++]);
+        stashed_count--;
+    }
+    stashed_head = 0;
+}
+
+void wait_for_credit(void *parent_data, local_id src, size_t frame_len) {
+    while (!flow_has_credit(src, frame_len)) {
+        Message ack_message;
+        int status = try_receive_any(parent_data, &ack_message);
+        if (status < 0) {
+            fprintf(stderr, "Error: parent failed while waiting for a credit of process %d\n", src);
+            exit(EXIT_FAILURE);
+        }
+        if (status == 0) {
+            stash_ack(&ack_message);
+        } else if (wait_any_readable(parent_data, 0) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void transfer_issue(void *parent_data, local_id src, local_id dst, balance_t amount,
+                    const void *tail, uint16_t tail_len) {
+    if (snapshot_poll(parent_data) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    wait_for_credit(parent_data, src, flow_transfer_frame_len(tail_len));
+    TransferOrder transfer_info;
+    transfer_info.s_src = src;
+    transfer_info.s_dst = dst;
+    transfer_info.s_amount = amount;
+    lmprd_time_upgrade();
+    mess_transfer_to(parent_data, &transfer_info, tail, tail_len);
+}
+
+int transfer_poll_ack(void *parent_data, Message *ack_message) {
+    int status = take_stashed_ack(ack_message) ? 0 : try_receive_any(parent_data, ack_message);
+    if (status != 0) {
+        return status;
+    }
+    lmprd_time_update(ack_message->s_header.s_local_time);
+    if (ack_message->s_header.s_type != ACK) {
+        fprintf(stderr, "Error: parent expected ACK, got message type %d\n", ack_message->s_header.s_type);
+        return -1;
+    }
+    return 0;
+}
+
+/// Children exit after STOP, so a snapshot still collecting reports has to end first.
+void finish_snapshot(void *parent_data) {
+    while (snapshot_in_progress()) {
+        Message ack_message;
+        int status = try_receive_any(parent_data, &ack_message);
+        if (status < 0) {
+            fprintf(stderr, "Error: parent failed while collecting a snapshot\n");
+            exit(EXIT_FAILURE);
+        }
+        if (status == 0) {
+            stash_ack(&ack_message);
+        } else if (snapshot_in_progress() && wait_any_readable(parent_data, 0) != 0) {
+            // the scan may have consumed the last report, nothing else is coming then
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void reset_process_state(void) {
+    lmprd_time_set(0);
+    ipc_stats_reset();
+    out_queue_reset();
+    flow_reset();
+    drop_stashed_acks();
+    snapshot_reset();
+    liveness_reset();
+}
+
+void run_processes(const RunConfig *config) {
+    RunShared shared;
+    shared.options = config->options;
+    int num_processes = config->num_processes;
+    reset_process_state();
+    profiler_start();
+
+    FILE *log_pipes, *log_events;
+    initialize_log_files(&log_pipes, &log_events);
+
+    Pipe **pipes = initialize_pipes(num_processes, log_pipes);
+
+    shared.events = open_shared_event_log(config->events_capacity);
+    shared.ipc_stats = ipc_stats_table_create();
+    shared.profile = profiler_table_create();
+    shared.live = NULL;
+    if (shared.options.live_stats_path != NULL) {
+        shared.live = live_stats_create(shared.options.live_stats_path, num_processes);
+    }
+    shared.barrier = NULL;
+    if (shared.options.shm_barrier) {
+        shared.barrier = shm_barrier_create();
+        if (shared.barrier == NULL) {
+            exit(1);
+        }
+    }
+    shm_barrier_bind(shared.barrier);
+    shared.slots = NULL;
+    if (shared.options.zero_copy) {
+        shared.slots = msg_slots_create();
+        if (shared.slots == NULL) {
+            exit(1);
+        }
+    }
+    msg_slots_bind(shared.slots);
+    mtree_configure(shared.options.multicast_fanout);
+    mutex_configure(shared.options.mutex);
+    liveness_set_timeout(shared.options.timeout_ms);
+    // a write to a peer that died fails with EPIPE and is reported instead of killing us
+    signal(SIGPIPE, SIG_IGN);
+    if (shared.options.snapshot) {
+        snapshot_configure(shared.options.snapshot_every);
+    }
+    create_child_processes_and_handle_pipes(num_processes, pipes, config, log_pipes, &shared);
+    evlog_init(shared.events);
+    open_trace(&shared, PARENT_ID, num_processes, 0);
+
+    Process parent_proc = {.num_process = num_processes, .pipes = pipes, .pid = PARENT_ID};
+    bind_channels(&parent_proc);
+    live_stats_bind(shared.live, PARENT_ID);
+    drop_pipes_that_non_rel(&parent_proc, log_pipes);
+
+    profiler_enter(PHASE_STARTED_BARRIER);
+    verify_received_messages(&parent_proc, log_pipes, STARTED, log_events);
+
+    handle_parent_process_logic(&parent_proc, config, log_events, log_pipes);
+    close_pipes_and_cleanup(&parent_proc, log_pipes, log_events, &shared, config->result);
+}
@@ -0,0 +1,56 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdint.h>
+
+#include "base_vars.h"
+#include "options.h"
+
+/**
+ * Parent side of a run, executed between the STARTED and DONE barriers.
+ * pa_program runs bank_robbery() here, the benchmarks plug in their own
+ * generators.
+ */
+typedef void (*ParentWorkload)(Process *parent_proc, void *workload_arg);
+
+/**
+ * Optional child side, run by every child right after the STARTED barrier
+ * and before it starts serving transfers, e.g. the --mutexl loop.
+ */
+typedef void (*ChildWorkload)(Process *child_proc, void *workload_arg);
+
+/**
+ * Totals of one run aggregated by the parent from the IPC stats and phase
+ * profile tables once every child has exited.
+ */
+typedef struct {
+    uint64_t messages;              ///< sent by all processes
+    uint64_t bytes;
+    uint64_t transfer_messages;     ///< TRANSFER and ACK frames only
+    uint64_t cs_messages;           ///< CS_REQUEST, CS_REPLY, CS_RELEASE and CS_TOKEN frames
+    uint64_t cpu_ns;                ///< all processes, all phases
+    uint64_t transfer_cpu_ns;       ///< all processes, transfer phase
+    uint64_t phase_wall_ns[PHASE_COUNT];    ///< longest process of each phase
+} RunResult;
+
+typedef struct {
+    int num_processes;          ///< including the parent
+    const int *balances;        ///< initial balance of children 1..num_processes-1
+    RunOptions options;
+    ParentWorkload workload;
+    void *workload_arg;
+    ChildWorkload child_workload;   ///< NULL when children only serve transfers
+    void *child_workload_arg;
+    uint32_t events_capacity;   ///< slots of the shared event log, 0 for the default
+    int print_history;          ///< print_history() of the collected BALANCE_HISTORY messages
+    RunResult *result;          ///< optional, filled in when the run is over
+} RunConfig;
+
+void run_processes(const RunConfig *config);
+
+void transfer_issue(void *parent_data, local_id src, local_id dst, balance_t amount,
+                    const void *tail, uint16_t tail_len);
+
+int transfer_poll_ack(void *parent_data, Message *ack_message);
+
+#endif
@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shared_log.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static size_t shared_log_bytes(uint32_t capacity) {
+    return sizeof(SharedLog) + (size_t) capacity * sizeof(SharedLogSlot);
+}
+
+SharedLog* shared_log_create(const char* path, uint32_t capacity) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Failed to create shared event log");
+        return NULL;
+    }
+    size_t bytes = shared_log_bytes(capacity);
+    if (ftruncate(fd, bytes) != 0) {
+        perror("Failed to size shared event log");
+        close(fd);
+        return NULL;
+    }
+    SharedLog* log = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (log == MAP_FAILED) {
+        perror("Failed to map shared event log");
+        return NULL;
+    }
+    log->sl_magic = SHARED_LOG_MAGIC;
+    log->sl_capacity = capacity;
+    log->sl_tail = 0;
+    log->sl_dropped = 0;
+    return log;
+}
+
+SharedLog* shared_log_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open shared event log");
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(SharedLog)) {
+        fprintf(stderr, "Error: %s is not a shared event log\n", path);
+        close(fd);
+        return NULL;
+    }
+    SharedLog* log = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (log == MAP_FAILED) {
+        perror("Failed to map shared event log");
+        return NULL;
+    }
+    // shared_log_close() unmaps shared_log_bytes(), so the file must be exactly that long
+    if (log->sl_magic != SHARED_LOG_MAGIC || shared_log_bytes(log->sl_capacity) != (size_t) info.st_size) {
+        fprintf(stderr, "Error: %s is not a shared event log\n", path);
+        munmap(log, info.st_size);
+        return NULL;
+    }
+    return log;
+}
+
+void shared_log_close(SharedLog* log) {
+    if (log != NULL) {
+        munmap(log, shared_log_bytes(log->sl_capacity));
+    }
+}
+
+void shared_log_append(SharedLog* log, const EventRecord* records, uint32_t count) {
+    uint32_t first = __atomic_fetch_add(&log->sl_tail, count, __ATOMIC_RELAXED);
+    for (uint32_t idx = 0; idx < count; idx++) {
+        uint32_t slot = first + idx;
+        if (slot >= log->sl_capacity) {
+            __atomic_fetch_add(&log->sl_dropped, count - idx, __ATOMIC_RELAXED);
+            return;
+        }
+        log->sl_slots[slot].s_record = records[idx];
+        __atomic_store_n(&log->sl_slots[slot].s_committed, 1, __ATOMIC_RELEASE);
+    }
+}
+
+uint32_t shared_log_size(const SharedLog* log) {
+    uint32_t tail = __atomic_load_n(&log->sl_tail, __ATOMIC_ACQUIRE);
+    return tail < log->sl_capacity ? tail : log->sl_capacity;
+}
+
+typedef struct {
+    EventRecord record;
+    uint32_t    order;
+} SortedEvent;
+
+static int compare_events(const void* lhs, const void* rhs) {
+    const SortedEvent* a = lhs;
+    const SortedEvent* b = rhs;
+    if (a->record.e_time != b->record.e_time) {
+        return a->record.e_time < b->record.e_time ? -1 : 1;
+    }
+    if (a->record.e_id != b->record.e_id) {
+        return a->record.e_id < b->record.e_id ? -1 : 1;
+    }
+    return a->order < b->order ? -1 : (a->order > b->order);
+}
+
+int shared_log_write_sorted(const SharedLog* log, FILE* output) {
+    uint32_t size = shared_log_size(log);
+    SortedEvent* events = malloc((size ? size : 1) * sizeof(SortedEvent));
+    if (events == NULL) {
+        perror("Failed to allocate event merge buffer");
+        return -1;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t slot = 0; slot < size; slot++) {
+        if (!__atomic_load_n(&log->sl_slots[slot].s_committed, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        events[count].record = log->sl_slots[slot].s_record;
+        events[count].order = slot;
+        count++;
+    }
+    qsort(events, count, sizeof(SortedEvent), compare_events);
+
+    char line[EVLOG_LINE_MAX];
+    for (uint32_t idx = 0; idx < count; idx++) {
+        int len = evlog_format(&events[idx].record, line, sizeof(line));
+        if (len > 0) {
+            fwrite(line, 1, len, output);
+        }
+    }
+    free(events);
+
+    uint32_t dropped = __atomic_load_n(&log->sl_dropped, __ATOMIC_RELAXED);
+    if (dropped > 0) {
+        fprintf(stderr, "Warning: shared event log overflowed, %u events dropped\n", dropped);
+    }
+    fflush(output);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef SHARED_LOG_H
+#define SHARED_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "event_log.h"
+
+typedef struct {
+    uint8_t     s_committed;  ///< set with release semantics once s_record is complete
+    EventRecord s_record;
+} __attribute__((packed)) SharedLogSlot;
+
+/**
+ * Event log region shared by all processes of a run. The parent maps it
+ * before fork(), every writer reserves slots with one atomic fetch-add on
+ * sl_tail, so appends never take a lock or touch stdio.
+ */
+typedef struct SharedLog {
+    uint32_t      sl_magic;
+    uint32_t      sl_capacity;  ///< number of slots
+    uint32_t      sl_tail;      ///< next free slot, may run past sl_capacity
+    uint32_t      sl_dropped;   ///< records lost because the region was full
+    SharedLogSlot sl_slots[];
+} SharedLog;
+
+enum {
+    SHARED_LOG_MAGIC = 0x45564C47,
+    SHARED_LOG_DEFAULT_CAPACITY = 1 << 16
+};
+
+SharedLog* shared_log_create(const char* path, uint32_t capacity);
+
+SharedLog* shared_log_open(const char* path);
+
+void shared_log_close(SharedLog* log);
+
+void shared_log_append(SharedLog* log, const EventRecord* records, uint32_t count);
+
+uint32_t shared_log_size(const SharedLog* log);
+
+int shared_log_write_sorted(const SharedLog* log, FILE* output);
+
+#endif
@@ -0,0 +1,83 @@
+#define _DEFAULT_SOURCE
+
+#include "shm_barrier.h"
+#include "liveness.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+
+ShmBarrier* shm_barrier = NULL;
+
+ShmBarrier* shm_barrier_create(void) {
+    ShmBarrier* barrier = mmap(NULL, sizeof(ShmBarrier), PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (barrier == MAP_FAILED) {
+        perror("Failed to map shared barrier");
+        return NULL;
+    }
+    return barrier;
+}
+
+void shm_barrier_destroy(ShmBarrier* barrier) {
+    if (barrier != NULL) {
+        munmap(barrier, sizeof(ShmBarrier));
+    }
+}
+
+void shm_barrier_bind(ShmBarrier* barrier) {
+    shm_barrier = barrier;
+}
+
+static ShmBarrierSlot* slot_of(MessageType type) {
+    return &shm_barrier->slots[type == DONE ? DONE : STARTED];
+}
+
+void shm_barrier_arrive(MessageType type, timestamp_t time) {
+    ShmBarrierSlot* slot = slot_of(type);
+    int32_t seen = __atomic_load_n(&slot->b_max_time, __ATOMIC_RELAXED);
+    while (seen < time && !__atomic_compare_exchange_n(&slot->b_max_time, &seen, time, 0,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    // the release orders the maximum before the arrival that publishes it
+    __atomic_add_fetch(&slot->b_arrived, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &slot->b_arrived, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/// Sleeps in slices of LIVENESS_SLICE_MS, like the receives of ipc.c, so a process that died before arriving is noticed.
+timestamp_t shm_barrier_wait(MessageType type, int arrivals, local_id self, uint64_t deadline_ns) {
+    ShmBarrierSlot* slot = slot_of(type);
+    uint32_t seen;
+    while ((seen = __atomic_load_n(&slot->b_arrived, __ATOMIC_ACQUIRE)) < (uint32_t) arrivals) {
+        uint64_t slice_ms = LIVENESS_SLICE_MS;
+        if (deadline_ns != 0) {
+            uint64_t now_ns = liveness_now_ns();
+            if (now_ns >= deadline_ns) {
+                fprintf(stderr, "Error: process %d timed out at the %s barrier, %u of %d arrived\n",
+                        self, type == DONE ? "DONE" : "STARTED", seen, arrivals);
+                return -1;
+            }
+            if ((deadline_ns - now_ns) / 1000000 < slice_ms) {
+                slice_ms = (deadline_ns - now_ns) / 1000000 + 1;
+            }
+        }
+        struct timespec slice = {.tv_sec = slice_ms / 1000, .tv_nsec = (slice_ms % 1000) * 1000000};
+        if (syscall(SYS_futex, &slot->b_arrived, FUTEX_WAIT, seen, &slice, NULL, 0) == 0) {
+            continue;
+        }
+        if (errno == ETIMEDOUT) {
+            if (liveness_check(self) != 0) {
+                return -1;
+            }
+        } else if (errno != EAGAIN && errno != EINTR) {
+            perror("Failed to wait on shared barrier");
+            return -1;
+        }
+    }
+    return (timestamp_t) __atomic_load_n(&slot->b_max_time, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,39 @@
+#ifndef SHM_BARRIER_H
+#define SHM_BARRIER_H
+
+#include <stdint.h>
+
+#include "ipc.h"
+
+/**
+ * Shared-memory replacement of the STARTED and DONE message exchange,
+ * enabled with --barrier. A child announcing STARTED/DONE raises the
+ * slot's Lamport maximum and bumps the arrival counter instead of
+ * multicasting; waiters sleep on the counter with a futex. Leaving the
+ * barrier counts as receiving one message stamped with that maximum.
+ */
+typedef struct {
+    uint32_t b_arrived;     ///< futex word
+    int32_t  b_max_time;
+} ShmBarrierSlot;
+
+typedef struct {
+    ShmBarrierSlot slots[DONE + 1];     ///< indexed by STARTED and DONE
+} ShmBarrier;
+
+/// Mapping of the current run, NULL when STARTED and DONE go through the pipes.
+extern ShmBarrier* shm_barrier;
+
+ShmBarrier* shm_barrier_create(void);
+
+void shm_barrier_destroy(ShmBarrier* barrier);
+
+void shm_barrier_bind(ShmBarrier* barrier);
+
+void shm_barrier_arrive(MessageType type, timestamp_t time);
+
+/// Blocks until arrivals processes have arrived, returns their latest Lamport time or -1.
+/// Fails when deadline_ns (0 for none) passes or a process is gone, see liveness_check().
+timestamp_t shm_barrier_wait(MessageType type, int arrivals, local_id self, uint64_t deadline_ns);
+
+#endif
@@ -0,0 +1,453 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../helpers.h"
+#include "../event_log.h"
+#include "../message_flags.h"
+#include "../bench/bench_rng.h"
+#include "sim_queue.h"
+
+/*
+ * Discrete-event simulation of a whole run inside one process. Every child
+ * is a virtual process driven by the real ops_step(); the parent is a small
+ * state machine issuing transfers like transfer() does. This file provides
+ * the send API of ipc.h: a sent message becomes an event delivered after a
+ * delay drawn from the channel model, and channels stay FIFO like pipes.
+ * Lamport time is a global of helpers.c, so it is swapped in and out with
+ * lmprd_time_set() around every virtual process step.
+ */
+
+enum {
+    SIM_MAX_CHILDREN = INT8_MAX,    ///< local_id is an int8_t
+    SIM_MAX_TRANSFERS = 8000,       ///< keeps the parent's int16 Lamport time from wrapping
+    SIM_BALANCE = 1000
+};
+
+typedef enum {
+    DELAY_CONSTANT,
+    DELAY_UNIFORM,
+    DELAY_EXPONENTIAL
+} DelayKind;
+
+typedef struct {
+    DelayKind kind;
+    double    a;        ///< constant or mean or lower bound, ns
+    double    b;        ///< upper bound of DELAY_UNIFORM, ns
+} DelayModel;
+
+typedef enum {
+    SIM_UNIFORM,
+    SIM_RING
+} SimWorkload;
+
+typedef struct {
+    int         children;
+    long        transfers;
+    long        window;
+    uint64_t    seed;
+    DelayModel  delay;
+    SimWorkload workload;
+    const char *delay_text;
+} SimOptions;
+
+typedef enum {
+    VP_STARTING,
+    VP_RUNNING,
+    VP_FINISHED
+} VProcState;
+
+typedef struct {
+    Process     proc;
+    OpsState    ops;
+    timestamp_t clock;
+    VProcState  state;
+    int         started;
+    Message   **deferred;   ///< arrived before the STARTED barrier completed
+    int         deferred_count;
+    int         deferred_capacity;
+} VProc;
+
+typedef struct {
+    SimOptions options;
+    int        num_process;
+    VProc     *vprocs;
+    SimQueue   queue;
+    uint64_t   now;
+    uint64_t  *channel_clear;   ///< [src * num_process + dst]: last delivery time on the channel
+    BenchRng   rng;
+    balance_t *available;       ///< parent's view of balances, so no transfer overdraws
+    long       issued;
+    long       acked;
+    int        parent_started;
+    int        parent_done;
+    int        parent_histories;
+    uint64_t   messages;
+    uint64_t   bytes;
+    uint64_t   events;
+} Sim;
+
+static Sim sim;
+
+static uint64_t sample_delay(void) {
+    const DelayModel *delay = &sim.options.delay;
+    switch (delay->kind) {
+        case DELAY_UNIFORM:
+            return delay->a + rng_uniform(&sim.rng) * (delay->b - delay->a);
+        case DELAY_EXPONENTIAL:
+            return rng_exponential(&sim.rng, delay->a);
+        default:
+            return delay->a;
+    }
+}
+
+int send_frame(void *self, local_id dst, const MessageFrame *msg) {
+    local_id src = ((Process *) self)->pid;
+    size_t len = sizeof(MessageHeader) + msg->s_header.s_payload_len;
+    Message *copy = malloc(len);
+    if (copy == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, msg, len);
+
+    uint64_t *clear = &sim.channel_clear[src * sim.num_process + dst];
+    uint64_t at = sim.now + sample_delay();
+    if (at < *clear) {
+        at = *clear;
+    }
+    *clear = at;
+    if (sim_queue_push(&sim.queue, at, src, dst, copy) != 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    sim.messages++;
+    sim.bytes += len;
+    return 0;
+}
+
+int send(void *self, local_id dst, const Message *msg) {
+    return send_frame(self, dst, message_frame(msg));
+}
+
+int send_multicast_frame(void *self, const MessageFrame *msg) {
+    Process *proc = self;
+    for (int dst = 0; dst < proc->num_process; dst++) {
+        if (dst != proc->pid) {
+            send_frame(self, dst, msg);
+        }
+    }
+    return 0;
+}
+
+int send_multicast(void *self, const Message *msg) {
+    return send_multicast_frame(self, message_frame(msg));
+}
+
+// Virtual processes never block: everything they receive is pushed to them.
+
+int receive(void *self, local_id from, Message *msg) {
+    (void) msg;
+    fprintf(stderr, "Error: process %d called receive(%d) inside the simulator\n", ((Process *) self)->pid, from);
+    return -1;
+}
+
+int try_receive_any(void *self, Message *msg) {
+    return receive(self, -1, msg);
+}
+
+int receive_any(void *self, Message *msg) {
+    return receive(self, -1, msg);
+}
+
+static void switch_to(VProc *vp) {
+    lmprd_time_set(vp->clock);
+}
+
+static void switch_from(VProc *vp) {
+    vp->clock = get_lamport_time();
+}
+
+static void pick_pair(local_id *src, local_id *dst) {
+    int children = sim.options.children;
+    if (sim.options.workload == SIM_RING) {
+        *src = 1 + sim.issued % children;
+        *dst = 1 + (sim.issued + 1) % children;
+        return;
+    }
+    *src = 1 + rng_below(&sim.rng, children);
+    *dst = 1 + rng_below(&sim.rng, children - 1);
+    if (*dst >= *src) {
+        (*dst)++;
+    }
+}
+
+/* parent: the part of runner.c and transfer() that decides what to send */
+
+static void parent_issue(Process *parent) {
+    while (sim.issued < sim.options.transfers && sim.issued - sim.acked < sim.options.window) {
+        TransferOrder order;
+        pick_pair(&order.s_src, &order.s_dst);
+        order.s_amount = sim.available[order.s_src] > 0 ? 1 : 0;
+        sim.available[order.s_src] -= order.s_amount;
+        sim.available[order.s_dst] += order.s_amount;
+        lmprd_time_upgrade();
+        mess_to(parent, TRANSFER, &order);
+        sim.issued++;
+    }
+    if (sim.acked == sim.options.transfers) {
+        mess_to(parent, STOP, NULL);
+    }
+}
+
+static void parent_receive(VProc *vp, const Message *msg) {
+    lmprd_time_update(msg->s_header.s_local_time);
+    // the parent's window stands in for the credits piggybacked on ACKs
+    switch (message_base_type(msg->s_header.s_type)) {
+        case STARTED:
+            if (++sim.parent_started == sim.options.children) {
+                evlog_push(EV_RECEIVED_ALL_STARTED, PARENT_ID, 0, get_lamport_time(), 0);
+                parent_issue(&vp->proc);
+            }
+            break;
+        case ACK:
+            sim.acked++;
+            parent_issue(&vp->proc);
+            break;
+        case DONE:
+            if (++sim.parent_done == sim.options.children) {
+                evlog_push(EV_RECEIVED_ALL_DONE, PARENT_ID, 0, get_lamport_time(), 0);
+            }
+            break;
+        case BALANCE_HISTORY:
+            if (++sim.parent_histories == sim.options.children) {
+                vp->state = VP_FINISHED;
+            }
+            break;
+        default:
+            fprintf(stderr, "Warning: parent received message type %d\n", msg->s_header.s_type);
+            break;
+    }
+}
+
+/* children: the STARTED barrier of runner.c, then ops_step() per message */
+
+static void child_step(VProc *vp, Message *msg) {
+    if (vp->state == VP_RUNNING && ops_step(&vp->proc, &vp->ops, msg)) {
+        vp->state = VP_FINISHED;
+    } else if (vp->state == VP_FINISHED) {
+        fprintf(stderr, "Warning: process %d received type %d after it finished\n", vp->proc.pid, msg->s_header.s_type);
+    }
+}
+
+static void child_barrier_passed(VProc *vp) {
+    evlog_push(EV_RECEIVED_ALL_STARTED, vp->proc.pid, 0, get_lamport_time(), 0);
+    vp->state = VP_RUNNING;
+    for (int i = 0; i < vp->deferred_count; i++) {
+        child_step(vp, vp->deferred[i]);
+        free(vp->deferred[i]);
+    }
+    vp->deferred_count = 0;
+}
+
+static void defer(VProc *vp, Message *msg) {
+    if (vp->deferred_count == vp->deferred_capacity) {
+        vp->deferred_capacity = vp->deferred_capacity ? 2 * vp->deferred_capacity : 8;
+        vp->deferred = realloc(vp->deferred, vp->deferred_capacity * sizeof(Message *));
+        if (vp->deferred == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    vp->deferred[vp->deferred_count++] = msg;
+}
+
+/// Returns 1 when the message was kept for later.
+static int child_receive(VProc *vp, Message *msg) {
+    if (vp->state != VP_STARTING) {
+        child_step(vp, msg);
+        return 0;
+    }
+    if (msg->s_header.s_type != STARTED) {
+        defer(vp, msg);
+        return 1;
+    }
+    lmprd_time_update(msg->s_header.s_local_time);
+    if (++vp->started == sim.options.children - 1) {
+        child_barrier_passed(vp);
+    }
+    return 0;
+}
+
+static void child_start(VProc *vp) {
+    update_chronicle(&vp->proc.history, get_lamport_time(), vp->proc.cur_balance, 0);
+    mess_to(&vp->proc, STARTED, NULL);
+    evlog_push_started(vp->proc.pid, get_lamport_time(), vp->proc.cur_balance, 0, 0);
+    if (sim.options.children == 1) {
+        child_barrier_passed(vp);
+    }
+}
+
+static void sim_setup(const SimOptions *options) {
+    memset(&sim, 0, sizeof(sim));
+    sim.options = *options;
+    sim.num_process = options->children + 1;
+    sim.vprocs = calloc(sim.num_process, sizeof(VProc));
+    sim.channel_clear = calloc((size_t) sim.num_process * sim.num_process, sizeof(uint64_t));
+    sim.available = calloc(sim.num_process, sizeof(balance_t));
+    if (sim.vprocs == NULL || sim.channel_clear == NULL || sim.available == NULL ||
+        sim_queue_init(&sim.queue, 4 * sim.num_process) != 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    rng_seed(&sim.rng, options->seed);
+    for (int id = 0; id < sim.num_process; id++) {
+        VProc *vp = &sim.vprocs[id];
+        vp->proc.num_process = sim.num_process;
+        vp->proc.pid = id;
+        vp->proc.cur_balance = id == PARENT_ID ? 0 : SIM_BALANCE;
+        vp->proc.history.s_id = id;
+        vp->state = id == PARENT_ID ? VP_RUNNING : VP_STARTING;
+        ops_state_init(&vp->ops);
+        sim.available[id] = vp->proc.cur_balance;
+    }
+}
+
+static void sim_run(void) {
+    for (int id = 1; id < sim.num_process; id++) {
+        switch_to(&sim.vprocs[id]);
+        child_start(&sim.vprocs[id]);
+        switch_from(&sim.vprocs[id]);
+    }
+    SimEvent event;
+    while (sim_queue_pop(&sim.queue, &event) == 0) {
+        sim.now = event.time;
+        sim.events++;
+        VProc *vp = &sim.vprocs[event.dst];
+        switch_to(vp);
+        int kept = 0;
+        if (event.dst == PARENT_ID) {
+            parent_receive(vp, event.msg);
+        } else {
+            kept = child_receive(vp, event.msg);
+        }
+        switch_from(vp);
+        if (!kept) {
+            free(event.msg);
+        }
+    }
+}
+
+static int sim_report(uint64_t wall_ns) {
+    long total = 0;
+    int unfinished = 0;
+    for (int id = 0; id < sim.num_process; id++) {
+        total += sim.vprocs[id].proc.cur_balance;
+        unfinished += sim.vprocs[id].state != VP_FINISHED;
+    }
+    long expected = (long) SIM_BALANCE * sim.options.children;
+    double virtual_s = sim.now / 1e9;
+    printf("{\"bench\":\"sim\",\"children\":%d,\"transfers\":%ld,\"window\":%ld,\"seed\":%llu,\"delay\":\"%s\","
+           "\"workload\":\"%s\",\"virtual_ns\":%llu,\"events\":%llu,\"messages\":%llu,\"bytes\":%llu,"
+           "\"wall_ns\":%llu,\"events_per_wall_sec\":%.0f,\"transfers_per_virtual_sec\":%.1f,"
+           "\"unfinished\":%d,\"money_conserved\":%s}\n",
+           sim.options.children, sim.options.transfers, sim.options.window, (unsigned long long) sim.options.seed,
+           sim.options.delay_text, sim.options.workload == SIM_RING ? "ring" : "uniform",
+           (unsigned long long) sim.now, (unsigned long long) sim.events, (unsigned long long) sim.messages,
+           (unsigned long long) sim.bytes, (unsigned long long) wall_ns,
+           sim.events * 1e9 / (wall_ns ? wall_ns : 1), virtual_s > 0 ? sim.acked / virtual_s : 0,
+           unfinished, total == expected ? "true" : "false");
+    return (unfinished == 0 && total == expected) ? 0 : 2;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: pa_sim [-p children] [--transfers K] [--window W] [--seed S]\n"
+                    "              [--delay constant:NS|uniform:MIN:MAX|exp:MEAN] [--workload uniform|ring]\n"
+                    "  children up to %d, transfers up to %d\n", SIM_MAX_CHILDREN, SIM_MAX_TRANSFERS);
+    exit(1);
+}
+
+static int parse_delay(const char *text, DelayModel *delay) {
+    if (sscanf(text, "constant:%lf", &delay->a) == 1) {
+        delay->kind = DELAY_CONSTANT;
+    } else if (sscanf(text, "uniform:%lf:%lf", &delay->a, &delay->b) == 2 && delay->b >= delay->a) {
+        delay->kind = DELAY_UNIFORM;
+    } else if (sscanf(text, "exp:%lf", &delay->a) == 1) {
+        delay->kind = DELAY_EXPONENTIAL;
+    } else {
+        return -1;
+    }
+    return delay->a >= 0 ? 0 : -1;
+}
+
+static void parse_options(int argc, char *argv[], SimOptions *options) {
+    options->children = 100;
+    options->transfers = 5000;
+    options->window = 1;
+    options->seed = 1;
+    options->delay_text = "exp:20000";
+    options->workload = SIM_UNIFORM;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage();
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            options->children = atoi(value);
+        } else if (strcmp(argv[i], "--transfers") == 0) {
+            options->transfers = atol(value);
+        } else if (strcmp(argv[i], "--window") == 0) {
+            options->window = atol(value);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--delay") == 0) {
+            options->delay_text = value;
+        } else if (strcmp(argv[i], "--workload") == 0) {
+            if (strcmp(value, "ring") == 0) {
+                options->workload = SIM_RING;
+            } else if (strcmp(value, "uniform") == 0) {
+                options->workload = SIM_UNIFORM;
+            } else {
+                usage();
+            }
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (parse_delay(options->delay_text, &options->delay) != 0 || options->children < 2 ||
+        options->children > SIM_MAX_CHILDREN || options->transfers < 0 ||
+        options->transfers > SIM_MAX_TRANSFERS || options->window <= 0) {
+        usage();
+    }
+}
+
+static uint64_t wall_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    SimOptions options;
+    parse_options(argc, argv, &options);
+
+    sim_setup(&options);
+    uint64_t start_ns = wall_now_ns();
+    sim_run();
+    int status = sim_report(wall_now_ns() - start_ns);
+
+    for (int id = 0; id < sim.num_process; id++) {
+        free(sim.vprocs[id].deferred);
+    }
+    sim_queue_free(&sim.queue);
+    free(sim.vprocs);
+    free(sim.channel_clear);
+    free(sim.available);
+    return status;
+}
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+
+#include "sim_queue.h"
+
+static int event_before(const SimEvent *a, const SimEvent *b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void swap_events(SimEvent *a, SimEvent *b) {
+    SimEvent tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+int sim_queue_init(SimQueue *queue, size_t capacity) {
+    queue->events = malloc(capacity * sizeof(SimEvent));
+    queue->count = 0;
+    queue->capacity = capacity;
+    queue->next_seq = 0;
+    return queue->events != NULL ? 0 : -1;
+}
+
+void sim_queue_free(SimQueue *queue) {
+    for (size_t i = 0; i < queue->count; i++) {
+        free(queue->events[i].msg);
+    }
+    free(queue->events);
+    queue->events = NULL;
+    queue->count = 0;
+}
+
+int sim_queue_push(SimQueue *queue, uint64_t time, local_id src, local_id dst, Message *msg) {
+    if (queue->count == queue->capacity) {
+        SimEvent *grown = realloc(queue->events, 2 * queue->capacity * sizeof(SimEvent));
+        if (grown == NULL) {
+            return -1;
+        }
+        queue->events = grown;
+        queue->capacity *= 2;
+    }
+    size_t idx = queue->count++;
+    SimEvent *events = queue->events;
+    events[idx].time = time;
+    events[idx].seq = queue->next_seq++;
+    events[idx].src = src;
+    events[idx].dst = dst;
+    events[idx].msg = msg;
+    while (idx > 0 && event_before(&events[idx], &events[(idx - 1) / 2])) {
+        swap_events(&events[idx], &events[(idx - 1) / 2]);
+        idx = (idx - 1) / 2;
+    }
+    return 0;
+}
+
+int sim_queue_pop(SimQueue *queue, SimEvent *event) {
+    if (queue->count == 0) {
+        return -1;
+    }
+    SimEvent *events = queue->events;
+    *event = events[0];
+    events[0] = events[--queue->count];
+    size_t idx = 0;
+    for (;;) {
+        size_t smallest = idx;
+        size_t left = 2 * idx + 1, right = 2 * idx + 2;
+        if (left < queue->count && event_before(&events[left], &events[smallest])) {
+            smallest = left;
+        }
+        if (right < queue->count && event_before(&events[right], &events[smallest])) {
+            smallest = right;
+        }
+        if (smallest == idx) {
+            break;
+        }
+        swap_events(&events[idx], &events[smallest]);
+        idx = smallest;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef SIM_QUEUE_H
+#define SIM_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../ipc.h"
+
+/**
+ * A message in flight between two virtual processes, delivered at a
+ * virtual time. Events with the same time come out in the order they were
+ * pushed, so a simulation is reproducible from its seed.
+ */
+typedef struct {
+    uint64_t time;      ///< virtual ns
+    uint64_t seq;
+    local_id src;
+    local_id dst;
+    Message *msg;       ///< owned by the event, sized to its payload
+} SimEvent;
+
+/// Binary min-heap of SimEvent ordered by (time, seq).
+typedef struct {
+    SimEvent *events;
+    size_t    count;
+    size_t    capacity;
+    uint64_t  next_seq;
+} SimQueue;
+
+int sim_queue_init(SimQueue *queue, size_t capacity);
+
+void sim_queue_free(SimQueue *queue);
+
+int sim_queue_push(SimQueue *queue, uint64_t time, local_id src, local_id dst, Message *msg);
+
+/// Returns 0 and the earliest event, or -1 when the queue is empty.
+int sim_queue_pop(SimQueue *queue, SimEvent *event);
+
+#endif
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "snapshot.h"
+#include "helpers.h"
+#include "message_flags.h"
+#include "message_pool.h"
+#include <signal.h>
+
+
+/// Payload of SNAPSHOT_REPORT, what one child recorded.
+typedef struct {
+    uint16_t  r_seq;
+    local_id  r_id;
+    balance_t r_balance;
+    balance_t r_in_transit;     ///< TRANSFERs to it caught on its channels
+} __attribute__((packed)) SnapshotReport;
+
+static volatile sig_atomic_t snapshot_requested = 0;
+static int snapshot_every = 0;
+static long transfers_seen = 0;
+
+/* parent */
+static uint16_t snapshot_seq = 0;
+static int reports_missing = 0;
+static timestamp_t snapshot_time = 0;
+static SnapshotReport reports[MAX_PROCESS_ID + 1];
+
+/* child */
+static int recording = 0;
+static int markers_missing = 0;
+static int marker_seen[MAX_PROCESS_ID + 1];
+static SnapshotReport recorded;
+
+static void on_sigusr1(int signo) {
+    (void) signo;
+    snapshot_requested = 1;
+}
+
+void snapshot_configure(int every) {
+    snapshot_every = every;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_sigusr1;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &action, NULL) != 0) {
+        perror("Failed to install the SIGUSR1 handler");
+    }
+}
+
+void snapshot_reset(void) {
+    snapshot_requested = 0;
+    snapshot_every = 0;
+    transfers_seen = 0;
+    snapshot_seq = 0;
+    reports_missing = 0;
+    recording = 0;
+}
+
+int snapshot_in_progress(void) {
+    return reports_missing > 0;
+}
+
+static int send_snapshot_message(Process* proc, local_id dst, int16_t type, const void* body, uint16_t body_len) {
+    SmallMessage small;
+    MessageFrame* frame = message_acquire(&small, body_len);
+    if (frame == NULL) {
+        return -1;
+    }
+    frame->s_header.s_magic = MESSAGE_MAGIC;
+    frame->s_header.s_type = type;
+    frame->s_header.s_local_time = get_lamport_time();
+    frame->s_header.s_payload_len = body_len;
+    memcpy(frame->s_payload, body, body_len);
+    int status = send_frame(proc, dst, frame);
+    message_release(&small, frame);
+    if (status != 0) {
+        fprintf(stderr, "Error: process %d failed to send a snapshot message to process %d\n", proc->pid, dst);
+        return -1;
+    }
+    return 0;
+}
+
+int snapshot_poll(Process* parent) {
+    transfers_seen++;
+    if (snapshot_every > 0 && transfers_seen % snapshot_every == 0) {
+        snapshot_requested = 1;
+    }
+    if (!snapshot_requested || snapshot_in_progress()) {
+        return 0;
+    }
+    snapshot_requested = 0;
+    snapshot_seq++;
+    snapshot_time = get_lamport_time();
+    reports_missing = parent->num_process - 1;
+    for (local_id dst = 1; dst < parent->num_process; dst++) {
+        if (send_snapshot_message(parent, dst, SNAPSHOT_MARKER, &snapshot_seq, sizeof(snapshot_seq)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void print_snapshot(int num_process) {
+    int balances = 0;
+    int in_transit = 0;
+    for (local_id id = 1; id < num_process; id++) {
+        balances += reports[id].r_balance;
+        in_transit += reports[id].r_in_transit;
+    }
+    fprintf(stderr, "snapshot %d at time %d: total $%d, $%d in balances, $%d in transit\n",
+            snapshot_seq, snapshot_time, balances + in_transit, balances, in_transit);
+    for (local_id id = 1; id < num_process; id++) {
+        fprintf(stderr, "  process %d: balance $%d, $%d in transit to it\n",
+                id, reports[id].r_balance, reports[id].r_in_transit);
+    }
+}
+
+static int on_report(Process* parent, const Message* msg) {
+    SnapshotReport report;
+    memcpy(&report, msg->s_payload, sizeof(report));
+    if (report.r_seq != snapshot_seq || report.r_id < 1 || report.r_id >= parent->num_process) {
+        fprintf(stderr, "Error: parent received a stray snapshot report from process %d\n", report.r_id);
+        return -1;
+    }
+    reports[report.r_id] = report;
+    if (--reports_missing == 0) {
+        print_snapshot(parent->num_process);
+    }
+    return 1;
+}
+
+static int start_recording(Process* proc, uint16_t seq) {
+    recording = 1;
+    markers_missing = proc->num_process - 1;
+    memset(marker_seen, 0, sizeof(marker_seen));
+    recorded.r_seq = seq;
+    recorded.r_id = proc->pid;
+    recorded.r_balance = proc->cur_balance + deferred_incoming(proc->pid);
+    recorded.r_in_transit = 0;
+    for (local_id dst = 1; dst < proc->num_process; dst++) {
+        if (dst != proc->pid && send_snapshot_message(proc, dst, SNAPSHOT_MARKER, &seq, sizeof(seq)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int on_marker(Process* proc, local_id src, const Message* msg) {
+    uint16_t seq;
+    memcpy(&seq, msg->s_payload, sizeof(seq));
+    if (!recording && start_recording(proc, seq) != 0) {
+        return -1;
+    }
+    if (seq != recorded.r_seq || marker_seen[src]) {
+        fprintf(stderr, "Error: process %d received a stray snapshot marker from process %d\n", proc->pid, src);
+        return -1;
+    }
+    marker_seen[src] = 1;
+    if (--markers_missing > 0) {
+        return 1;
+    }
+    recording = 0;
+    if (send_snapshot_message(proc, PARENT_ID, SNAPSHOT_REPORT, &recorded, sizeof(recorded)) != 0) {
+        return -1;
+    }
+    return 1;
+}
+
+int snapshot_on_receive(Process* proc, local_id src, const Message* msg) {
+    switch (msg->s_header.s_type) {
+        case SNAPSHOT_MARKER:
+            return on_marker(proc, src, msg);
+        case SNAPSHOT_REPORT:
+            return on_report(proc, msg);
+        case TRANSFER:
+            if (recording && !marker_seen[src] && src != PARENT_ID) {
+                const TransferOrder* order = (const TransferOrder*) msg->s_payload;
+                if (order->s_dst == proc->pid) {
+                    recorded.r_in_transit += order->s_amount;
+                }
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "base_vars.h"
+
+/**
+ * Chandy-Lamport snapshots of all balances while transfers keep flowing,
+ * enabled with --snapshot[=k]. The parent starts one on SIGUSR1, and every
+ * k transfers when k is given, by sending a SNAPSHOT_MARKER to every child.
+ * On its first marker a child records its balance, plus the TRANSFERs it
+ * received but has not applied yet, and forwards a marker to every other
+ * child. Until the marker of a channel arrives, the TRANSFERs received on
+ * it are recorded as money in transit. Once it has a marker from every
+ * channel, the child sends its SNAPSHOT_REPORT to the parent. The parent
+ * prints the global view when every report is in. Money only travels
+ * between children, so the parent records no channel of its own.
+ *
+ * Markers and reports are consumed inside receive() and receive_any(), so
+ * no loop of the banking code ever sees them. They also leave the Lamport
+ * clock alone, so the histories are the same with and without snapshots.
+ */
+
+/// Installs the SIGUSR1 handler before fork(), so a signal to the whole group spares the children.
+void snapshot_configure(int every);
+
+void snapshot_reset(void);
+
+/// Called by the parent before each transfer, starts a snapshot when one is due.
+int snapshot_poll(Process* parent);
+
+int snapshot_in_progress(void);
+
+/// Returns 1 when the message was a marker or a report and has been consumed, -1 on error.
+int snapshot_on_receive(Process* proc, local_id src, const Message* msg);
+
+#endif
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../shared_log.h"
+
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : "events.bin";
+    SharedLog *log = shared_log_open(path);
+    if (!log) {
+        return 1;
+    }
+
+    char line[EVLOG_LINE_MAX];
+    uint32_t size = shared_log_size(log);
+    for (uint32_t slot = 0; slot < size; slot++) {
+        if (!log->sl_slots[slot].s_committed) {
+            continue;
+        }
+        EventRecord record = log->sl_slots[slot].s_record;
+        int len = evlog_format(&record, line, sizeof(line));
+        if (len < 0) {
+            fprintf(stderr, "Unknown event type %d\n", record.e_type);
+            continue;
+        }
+        fwrite(line, 1, len, stdout);
+    }
+
+    shared_log_close(log);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../shared_log.h"
+
+
+int main(int argc, char *argv[]) {
+    const char *input_path = (argc > 1) ? argv[1] : "events.bin";
+    const char *output_path = (argc > 2) ? argv[2] : "events.log";
+
+    SharedLog *log = shared_log_open(input_path);
+    if (!log) {
+        return 1;
+    }
+    FILE *output = fopen(output_path, "w");
+    if (!output) {
+        perror("Failed to open merged event log");
+        shared_log_close(log);
+        return 1;
+    }
+
+    int status = shared_log_write_sorted(log, output);
+
+    fclose(output);
+    shared_log_close(log);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../helpers.h"
+#include "../message_flags.h"
+#include "../trace.h"
+
+/*
+ * Replays the inbound messages of one child's trace (see --trace) through
+ * the real message handling code with no peers: this file provides the
+ * send/receive API of ipc.h, so linking it instead of ipc.c turns
+ * ops_commands() into a pure function of the trace. Receives return the
+ * recorded inbound messages in their original order; sends are checked
+ * against the recorded outbound stream and every difference is reported,
+ * which makes a trace usable as a regression test.
+ */
+
+typedef struct {
+    const TraceFile *trace;
+    uint8_t         *consumed;
+    uint32_t         next_any;
+    uint32_t         next_from[MAX_PROCESS_ID + 1];
+    uint32_t         next_sent;
+    long             delivered;
+    long             sent;
+    long             mismatches;
+    int              quiet;
+} Replay;
+
+static Replay replay;
+
+static int is_inbound(uint32_t idx) {
+    return replay.trace->records[idx]->t_dir == TRACE_RECEIVED && !replay.consumed[idx];
+}
+
+static void deliver(uint32_t idx, Message *msg) {
+    const TraceRecord *record = replay.trace->records[idx];
+    memcpy(&msg->s_header, &record->t_header, sizeof(MessageHeader));
+    memcpy(msg->s_payload, trace_payload(record), msg->s_header.s_payload_len);
+    replay.consumed[idx] = 1;
+    replay.delivered++;
+}
+
+int receive(void *self, local_id from, Message *msg) {
+    (void) self;
+    uint32_t *next = &replay.next_from[from];
+    while (*next < replay.trace->count && !(is_inbound(*next) && replay.trace->records[*next]->t_src == from)) {
+        (*next)++;
+    }
+    if (*next == replay.trace->count) {
+        fprintf(stderr, "Replay: no more recorded messages from process %d\n", from);
+        return -1;
+    }
+    deliver((*next)++, msg);
+    return 0;
+}
+
+int try_receive_any(void *self, Message *msg) {
+    (void) self;
+    while (replay.next_any < replay.trace->count && !is_inbound(replay.next_any)) {
+        replay.next_any++;
+    }
+    if (replay.next_any == replay.trace->count) {
+        return 1;
+    }
+    deliver(replay.next_any++, msg);
+    return 0;
+}
+
+int receive_any(void *self, Message *msg) {
+    int status = try_receive_any(self, msg);
+    if (status == 1) {
+        fprintf(stderr, "Replay: trace exhausted while waiting for a message\n");
+        return -1;
+    }
+    return status;
+}
+
+static void report_mismatch(const char *what, local_id dst, const MessageFrame *msg) {
+    replay.mismatches++;
+    if (!replay.quiet) {
+        fprintf(stderr, "Replay: send #%ld to %d (type %d, time %d, %d bytes): %s\n", replay.sent, dst,
+                msg->s_header.s_type, msg->s_header.s_local_time, msg->s_header.s_payload_len, what);
+    }
+}
+
+int send_frame(void *self, local_id dst, const MessageFrame *msg) {
+    (void) self;
+    replay.sent++;
+    const TraceFile *trace = replay.trace;
+    while (replay.next_sent < trace->count && trace->records[replay.next_sent]->t_dir != TRACE_SENT) {
+        replay.next_sent++;
+    }
+    if (replay.next_sent == trace->count) {
+        report_mismatch("not in the trace", dst, msg);
+        return 0;
+    }
+    const TraceRecord *record = trace->records[replay.next_sent++];
+    MessageHeader recorded;
+    memcpy(&recorded, &record->t_header, sizeof(MessageHeader));
+    if (record->t_dst != dst || recorded.s_type != msg->s_header.s_type) {
+        report_mismatch("different destination or type", dst, msg);
+    } else if (recorded.s_local_time != msg->s_header.s_local_time) {
+        report_mismatch("different Lamport time", dst, msg);
+    } else if (msg->s_header.s_type != STARTED &&
+               (recorded.s_payload_len != msg->s_header.s_payload_len ||
+                memcmp(trace_payload(record), msg->s_payload, recorded.s_payload_len) != 0)) {
+        // STARTED text carries pids, which change from run to run
+        report_mismatch("different payload", dst, msg);
+    }
+    return 0;
+}
+
+int send(void *self, local_id dst, const Message *msg) {
+    return send_frame(self, dst, message_frame(msg));
+}
+
+int send_multicast_frame(void *self, const MessageFrame *msg) {
+    Process *proc = self;
+    for (local_id dst = 0; dst < proc->num_process; dst++) {
+        if (dst != proc->pid) {
+            send_frame(self, dst, msg);
+        }
+    }
+    return 0;
+}
+
+int send_multicast(void *self, const Message *msg) {
+    return send_multicast_frame(self, message_frame(msg));
+}
+
+static void replay_once(const TraceFile *trace) {
+    memset(replay.consumed, 0, trace->count);
+    replay.next_any = 0;
+    memset(replay.next_from, 0, sizeof(replay.next_from));
+    replay.next_sent = 0;
+    lmprd_time_set(0);
+
+    Process proc;
+    memset(&proc, 0, sizeof(proc));
+    proc.num_process = trace->header.f_num_process;
+    proc.pid = trace->header.f_id;
+    proc.cur_balance = trace->header.f_initial_balance;
+    proc.history.s_id = proc.pid;
+
+    // the same steps as a forked child in runner.c
+    update_chronicle(&proc.history, get_lamport_time(), proc.cur_balance, 0);
+    mess_to(&proc, STARTED, NULL);
+    if (is_every_get(&proc, STARTED) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    ops_commands(&proc);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    long repeat = 1;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            replay.quiet = 1;
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL || repeat <= 0) {
+        fprintf(stderr, "Usage: pa_replay [--repeat K] [--quiet] trace.<id>.bin\n");
+        return 1;
+    }
+
+    TraceFile trace;
+    if (trace_load(path, &trace) != 0) {
+        return 1;
+    }
+    if (trace.header.f_id == PARENT_ID || trace.header.f_num_process > MAX_PROCESS_ID + 1) {
+        fprintf(stderr, "Error: %s is not the trace of a child process\n", path);
+        trace_free(&trace);
+        return 1;
+    }
+    for (uint32_t idx = 0; idx < trace.count; idx++) {
+        MessageHeader header;
+        memcpy(&header, &trace.records[idx]->t_header, sizeof(MessageHeader));
+        if (message_root(header.s_type) >= 0) {
+            // forwarding along the tree is not part of the banking code being replayed
+            fprintf(stderr, "Error: %s was recorded with --tree and cannot be replayed\n", path);
+            trace_free(&trace);
+            return 1;
+        }
+    }
+    replay.trace = &trace;
+    replay.consumed = malloc(trace.count ? trace.count : 1);
+    if (replay.consumed == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        trace_free(&trace);
+        return 1;
+    }
+
+    uint64_t start_ns = now_ns();
+    for (long run = 0; run < repeat; run++) {
+        replay_once(&trace);
+    }
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    long left = 0;
+    for (uint32_t idx = 0; idx < trace.count; idx++) {
+        left += is_inbound(idx);
+    }
+    printf("process %d: %ld messages delivered, %ld sent in %ld run(s), %.3f ms, %.0f msgs/s\n",
+           trace.header.f_id, replay.delivered, replay.sent, repeat, elapsed_ns / 1e6,
+           replay.delivered * 1e9 / (elapsed_ns ? elapsed_ns : 1));
+    printf("%ld send mismatch(es), %ld recorded message(s) never received\n", replay.mismatches, left);
+
+    free(replay.consumed);
+    trace_free(&trace);
+    return (replay.mismatches == 0 && left == 0) ? 0 : 2;
+}
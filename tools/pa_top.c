@@ -0,0 +1,94 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../live_stats.h"
+
+
+typedef struct {
+    uint64_t msgs;
+    uint64_t updated_ns;
+} RateSample;
+
+static void sleep_ms(long milliseconds) {
+    struct timespec delay = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+    nanosleep(&delay, NULL);
+}
+
+static uint64_t inbound_queue_depth(const LiveSlot *slots, int num_process, int id) {
+    uint64_t depth = 0;
+    for (int src = 0; src < num_process; src++) {
+        if (src == id || slots[src].l_sent_to[id] <= slots[id].l_received_from[src]) {
+            continue;
+        }
+        depth += slots[src].l_sent_to[id] - slots[id].l_received_from[src];
+    }
+    return depth;
+}
+
+static void render(const LiveStatsPage *page, RateSample *previous) {
+    int num_process = page->ls_num_process;
+    LiveSlot slots[MAX_PROCESS_ID + 1];
+    memset(slots, 0, sizeof(slots));
+    for (int id = 0; id < num_process; id++) {
+        live_stats_read(page, id, &slots[id]);
+    }
+
+    printf("\033[H\033[2J");
+    printf("pa_top - parent pid %d, %d processes%s\n\n", page->ls_parent_pid, num_process,
+           page->ls_finished ? " (finished)" : "");
+    printf("%3s %7s %8s %8s %8s %10s %10s %9s %7s\n",
+           "id", "pid", "lamport", "balance", "pending", "sent", "received", "msg/s", "queue");
+    for (int id = 0; id < num_process; id++) {
+        const LiveSlot *slot = &slots[id];
+        uint64_t msgs = slot->l_msgs_sent + slot->l_msgs_received;
+        double rate = 0.0;
+        if (slot->l_updated_ns > previous[id].updated_ns && previous[id].updated_ns != 0) {
+            rate = (msgs - previous[id].msgs) * 1e9 / (slot->l_updated_ns - previous[id].updated_ns);
+        }
+        previous[id].msgs = msgs;
+        previous[id].updated_ns = slot->l_updated_ns;
+
+        printf("%3d %7d %8d %8d %8u %10llu %10llu %9.0f %7llu\n", id, slot->l_pid, slot->l_lamport,
+               id == PARENT_ID ? 0 : slot->l_balance, slot->l_pending_transfers,
+               (unsigned long long) slot->l_msgs_sent, (unsigned long long) slot->l_msgs_received, rate,
+               (unsigned long long) inbound_queue_depth(slots, num_process, id));
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = live_stats_default_path;
+    long interval_ms = 500;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            interval_ms = atol(argv[++i]);
+        } else {
+            path = argv[i];
+        }
+    }
+    if (interval_ms <= 0) {
+        fprintf(stderr, "Usage: pa_top [-d interval_ms] [path]\n");
+        return 1;
+    }
+
+    LiveStatsPage *page = live_stats_attach(path);
+    if (!page) {
+        return 1;
+    }
+
+    RateSample previous[MAX_PROCESS_ID + 1];
+    memset(previous, 0, sizeof(previous));
+    while (1) {
+        render(page, previous);
+        if (page->ls_finished || kill(page->ls_parent_pid, 0) != 0) {
+            break;
+        }
+        sleep_ms(interval_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+FILE* trace_stream = NULL;
+static char* trace_buffer = NULL;
+
+enum {
+    TRACE_BUFFER_SIZE = 1 << 20
+};
+
+int trace_open(const char* prefix, local_id id, int num_process, balance_t initial_balance) {
+    char path[TRACE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s.%d.bin", prefix, id);
+    trace_stream = fopen(path, "wb");
+    if (trace_stream == NULL) {
+        perror("Failed to open trace file");
+        return -1;
+    }
+    // records are small, so let stdio batch them into large writes
+    trace_buffer = malloc(TRACE_BUFFER_SIZE);
+    if (trace_buffer != NULL) {
+        setvbuf(trace_stream, trace_buffer, _IOFBF, TRACE_BUFFER_SIZE);
+    }
+    TraceFileHeader header = {TRACE_MAGIC, TRACE_VERSION, id, num_process, initial_balance};
+    fwrite(&header, sizeof(header), 1, trace_stream);
+    return 0;
+}
+
+void trace_write(TraceDirection dir, local_id src, local_id dst, const MessageFrame* frame) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    TraceRecord record;
+    record.t_ns = (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+    record.t_dir = dir;
+    record.t_src = src;
+    record.t_dst = dst;
+    record.t_header = frame->s_header;
+    fwrite(&record, sizeof(record), 1, trace_stream);
+    fwrite(frame->s_payload, 1, frame->s_header.s_payload_len, trace_stream);
+}
+
+void trace_close(void) {
+    if (trace_stream == NULL) {
+        return;
+    }
+    if (fclose(trace_stream) != 0) {
+        perror("Failed to write trace file");
+    }
+    trace_stream = NULL;
+    free(trace_buffer);
+    trace_buffer = NULL;
+}
+
+static int read_whole_file(const char* path, char** data, long* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    *data = malloc(*size > 0 ? *size : 1);
+    if (*data == NULL || fread(*data, 1, *size, file) != (size_t) *size) {
+        fprintf(stderr, "Error: cannot read %s\n", path);
+        free(*data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    return 0;
+}
+
+int trace_load(const char* path, TraceFile* trace) {
+    memset(trace, 0, sizeof(TraceFile));
+    long size;
+    if (read_whole_file(path, &trace->data, &size) != 0) {
+        return -1;
+    }
+    if (size < (long) sizeof(TraceFileHeader)) {
+        fprintf(stderr, "Error: %s is not a trace file\n", path);
+        trace_free(trace);
+        return -1;
+    }
+    memcpy(&trace->header, trace->data, sizeof(TraceFileHeader));
+    if (trace->header.f_magic != TRACE_MAGIC || trace->header.f_version != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s is not a version %d trace file\n", path, TRACE_VERSION);
+        trace_free(trace);
+        return -1;
+    }
+
+    uint32_t capacity = 1024;
+    trace->records = malloc(capacity * sizeof(TraceRecord*));
+    long offset = sizeof(TraceFileHeader);
+    while (trace->records != NULL && offset + (long) sizeof(TraceRecord) <= size) {
+        const TraceRecord* record = (const TraceRecord*) (trace->data + offset);
+        long next = offset + sizeof(TraceRecord) + record->t_header.s_payload_len;
+        if (next > size) {
+            break;
+        }
+        if (trace->count == capacity) {
+            capacity *= 2;
+            const TraceRecord** grown = realloc(trace->records, capacity * sizeof(TraceRecord*));
+            if (grown == NULL) {
+                break;
+            }
+            trace->records = grown;
+        }
+        trace->records[trace->count++] = record;
+        offset = next;
+    }
+    if (offset != size) {
+        fprintf(stderr, "Error: %s is truncated at byte %ld\n", path, offset);
+        trace_free(trace);
+        return -1;
+    }
+    return 0;
+}
+
+void trace_free(TraceFile* trace) {
+    free(trace->records);
+    free(trace->data);
+    trace->records = NULL;
+    trace->data = NULL;
+    trace->count = 0;
+}
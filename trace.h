@@ -0,0 +1,86 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ipc.h"
+#include "message_pool.h"
+#include "banking.h"
+
+/**
+ * Binary message trace of one process, written to "<prefix>.<id>.bin" when
+ * the run is started with --trace. The file starts with a TraceFileHeader,
+ * then holds one TraceRecord per message sent or received, each followed by
+ * s_payload_len payload bytes. tools/pa_replay feeds the received stream
+ * back into ops_commands().
+ */
+typedef struct {
+    uint32_t  f_magic;
+    uint16_t  f_version;
+    local_id  f_id;
+    uint8_t   f_num_process;
+    balance_t f_initial_balance;
+} __attribute__((packed)) TraceFileHeader;
+
+typedef enum {
+    TRACE_SENT = 0,
+    TRACE_RECEIVED
+} TraceDirection;
+
+typedef struct {
+    uint64_t      t_ns;         ///< CLOCK_MONOTONIC when the message left or arrived
+    uint8_t       t_dir;        ///< TraceDirection
+    local_id      t_src;
+    local_id      t_dst;
+    MessageHeader t_header;
+} __attribute__((packed)) TraceRecord;
+
+enum {
+    TRACE_MAGIC = 0x50415452,
+    TRACE_VERSION = 1,
+    TRACE_PATH_MAX = 256
+};
+
+static const char * const trace_default_prefix = "trace";
+
+extern FILE* trace_stream;
+
+int trace_open(const char* prefix, local_id id, int num_process, balance_t initial_balance);
+
+void trace_write(TraceDirection dir, local_id src, local_id dst, const MessageFrame* frame);
+
+void trace_close(void);
+
+static inline void trace_on_send(local_id src, local_id dst, const MessageFrame* frame) {
+    if (trace_stream != NULL) {
+        trace_write(TRACE_SENT, src, dst, frame);
+    }
+}
+
+static inline void trace_on_receive(local_id src, local_id dst, const Message* message) {
+    if (trace_stream != NULL) {
+        trace_write(TRACE_RECEIVED, src, dst, message_frame(message));
+    }
+}
+
+/**
+ * A trace file loaded into memory with an index of its records. A record's
+ * payload starts right after it.
+ */
+typedef struct {
+    TraceFileHeader     header;
+    char*               data;
+    const TraceRecord** records;
+    uint32_t            count;
+} TraceFile;
+
+int trace_load(const char* path, TraceFile* trace);
+
+void trace_free(TraceFile* trace);
+
+static inline const char* trace_payload(const TraceRecord* record) {
+    return (const char*) (record + 1);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+/**
+ * Static tracepoints of the "pa3" provider for perf and bpftrace, e.g.
+ *
+ *   bpftrace -e 'usdt:./pa_program:pa3:send_entry { @[arg3] = count(); }'
+ *
+ * Built with -DPA_USDT (make build-usdt) every probe is a single nop plus an
+ * ELF note, without it the macros expand to nothing. Probe arguments are
+ * (lamport time, src, dst, type) unless stated otherwise next to the probe.
+ */
+#ifdef PA_USDT
+
+#if defined(__has_include)
+#if !__has_include(<sys/sdt.h>)
+#error "PA_USDT requires <sys/sdt.h> (systemtap-sdt-dev / systemtap-sdt-devel)"
+#endif
+#endif
+
+#include <sys/sdt.h>
+
+#define PA_TRACE4(name, a1, a2, a3, a4) DTRACE_PROBE4(pa3, name, a1, a2, a3, a4)
+#define PA_TRACE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(pa3, name, a1, a2, a3, a4, a5)
+
+#else
+
+#define PA_TRACE4(name, a1, a2, a3, a4) ((void) 0)
+#define PA_TRACE5(name, a1, a2, a3, a4, a5) ((void) 0)
+
+#endif
+
+// send() entry and exit, exit carries the return status as the fifth argument
+#define TRACE_SEND_ENTRY(time, src, dst, type) PA_TRACE4(send_entry, time, src, dst, type)
+#define TRACE_SEND_RETURN(time, src, dst, type, status) PA_TRACE5(send_return, time, src, dst, type, status)
+
+// receive()/receive_any(): header read, then payload read with its length
+#define TRACE_RECEIVE_HEADER(time, src, dst, type) PA_TRACE4(receive_header, time, src, dst, type)
+#define TRACE_RECEIVE_PAYLOAD(time, src, dst, type, len) PA_TRACE5(receive_payload, time, src, dst, type, len)
+
+// transfer() in the parent: (time, src, dst, amount)
+#define TRACE_TRANSFER_START(time, src, dst, amount) PA_TRACE4(transfer_start, time, src, dst, amount)
+#define TRACE_TRANSFER_ACK(time, src, dst, amount) PA_TRACE4(transfer_ack, time, src, dst, amount)
+
+// handle_transfer() in a child: (time, src, dst, amount, id of the handling process)
+#define TRACE_HANDLE_TRANSFER(time, src, dst, amount, self) PA_TRACE5(handle_transfer, time, src, dst, amount, self)
+
+// update_chronicle(): (time, id, balance, pending in)
+#define TRACE_UPDATE_CHRONICLE(time, id, balance, delta) PA_TRACE4(update_chronicle, time, id, balance, delta)
+
+#endif